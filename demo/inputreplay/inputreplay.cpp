@@ -0,0 +1,178 @@
+/*  Berkelium - Embedded Chromium
+ *  inputreplay.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+
+#include "berkelium/Berkelium.hpp"
+#include "berkelium/Window.hpp"
+#include "berkelium/WindowDelegate.hpp"
+#include "berkelium/Context.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/select.h>
+#endif
+#include <memory>
+#include <string>
+
+using namespace Berkelium;
+
+// Loads a page without showing it, plays an input log from
+// Window::startInputRecording into it and prints the latencies, for
+// checking input handling in CI against local file:// pages. Exits
+// non-zero if the page or the log can't be loaded, or the replay doesn't
+// end in time.
+
+static const int WIDTH = 800;
+static const int HEIGHT = 600;
+
+class ReplayDelegate : public WindowDelegate {
+public:
+    ReplayDelegate() : mLoaded(false), mFailed(false), mDone(false) {}
+
+    bool loaded() const {
+        return mLoaded;
+    }
+    bool failed() const {
+        return mFailed;
+    }
+    bool done() const {
+        return mDone;
+    }
+
+    virtual void onLoadingStateChanged(Window *win, bool isLoading) {
+        if (!isLoading) {
+            mLoaded = true;
+        }
+    }
+    virtual void onLoadError(Window *win, WideString error) {
+        fprintf(stderr, "inputreplay: load error: %ls\n",
+                std::wstring(error.data(), error.length()).c_str());
+        mFailed = true;
+    }
+    virtual void onCrashed(Window *win) {
+        fprintf(stderr, "inputreplay: renderer crashed\n");
+        mFailed = true;
+    }
+    virtual void onInputReplayed(Window *win, size_t eventIndex,
+                                 double latency) {
+        printf("event %lu: %.2f ms\n", (unsigned long)eventIndex,
+               latency * 1000);
+    }
+    virtual void onInputReplayDone(Window *win) {
+        mDone = true;
+    }
+
+private:
+    bool mLoaded;
+    bool mFailed;
+    bool mDone;
+};
+
+static void pump() {
+    Berkelium::update();
+#ifdef _WIN32
+    Sleep(10);
+#else
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 10000;
+    select(0, NULL, NULL, NULL, &tv);
+#endif
+}
+
+// Pumps until the flag is set or the delegate failed, at most until end.
+static bool pumpUntil(const ReplayDelegate &delegate,
+                      bool (ReplayDelegate::*flag)() const, time_t end) {
+    while (!(delegate.*flag)() && !delegate.failed() && time(NULL) < end) {
+        pump();
+    }
+    return (delegate.*flag)() && !delegate.failed();
+}
+
+int main (int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s file:///page.html log [speed] [timeout]\n",
+                argv[0]);
+        return 2;
+    }
+    std::string url = argv[1];
+    std::string log = argv[2];
+#ifdef _WIN32
+    std::wstring logPath(log.begin(), log.end());
+#else
+    std::string logPath = log;
+#endif
+    double speed = argc < 4 ? 1 : atof(argv[3]);
+    int seconds = argc < 5 ? 60 : atoi(argv[4]);
+
+    Berkelium::init(FileString::empty());
+    Context *context = Context::create();
+    std::auto_ptr<Window> win(Window::create(context));
+    delete context;
+    ReplayDelegate delegate;
+    win->setDelegate(&delegate);
+    win->resize(WIDTH, HEIGHT);
+    win->focus();
+    win->navigateTo(URLString::point_to(url));
+
+    time_t end = time(NULL) + seconds;
+    int status = 1;
+    if (!pumpUntil(delegate, &ReplayDelegate::loaded, end)) {
+        fprintf(stderr, "inputreplay: %s did not load\n", url.c_str());
+    } else if (!win->startInputReplay(FileString::point_to(logPath), speed)) {
+        fprintf(stderr, "inputreplay: can't read %s\n", log.c_str());
+    } else if (!pumpUntil(delegate, &ReplayDelegate::done, end)) {
+        fprintf(stderr, "inputreplay: replay did not finish\n");
+        win->stopInputReplay();
+    } else {
+        status = 0;
+    }
+
+    InputReplayStats stats = win->getInputReplayStats();
+    printf("%u events, %u injected, %u painted, %u unpainted\n",
+           stats.events, stats.injected, stats.painted, stats.unpainted);
+    if (stats.painted) {
+        printf("latency: mean %.2f ms, max %.2f ms\n",
+               stats.totalLatency * 1000 / stats.painted,
+               stats.maxLatency * 1000);
+    }
+
+    win.reset();
+    Berkelium::destroy();
+    return status;
+}
@@ -0,0 +1,118 @@
+/*  Berkelium sample application
+ *  pixelbench.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/PixelConvert.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+using namespace Berkelium;
+
+// Times PixelConvert on a full 1080p frame and on a typical set of small
+// dirty rects, for every output format.
+
+static const struct {
+    PixelFormat format;
+    const char *name;
+} formats[] = {
+    {PIXEL_FORMAT_BGRA, "BGRA (copy)"},
+    {PIXEL_FORMAT_BGRA_UNPREMULTIPLIED, "BGRA unpremultiplied"},
+    {PIXEL_FORMAT_RGBA, "RGBA"},
+    {PIXEL_FORMAT_RGBA_UNPREMULTIPLIED, "RGBA unpremultiplied"},
+    {PIXEL_FORMAT_RGB24, "RGB24"},
+    {PIXEL_FORMAT_I420, "I420"}
+};
+
+static Rect makeRect(int left, int top, int width, int height) {
+    Rect r;
+    r.mLeft = left;
+    r.mTop = top;
+    r.mWidth = width;
+    r.mHeight = height;
+    return r;
+}
+
+static double run(PixelFormat format, const std::vector<unsigned char> &src,
+                  std::vector<unsigned char> &dest, int width, int height,
+                  const std::vector<Rect> &rects, int iterations) {
+    clock_t start = clock();
+    for (int i = 0; i < iterations; ++i) {
+        PixelConvert::convert(format, &src[0], width * 4, &dest[0],
+                              width, height, rects.size(), &rects[0]);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    double pixels = 0;
+    for (size_t i = 0; i < rects.size(); ++i) {
+        pixels += (double)rects[i].width() * rects[i].height();
+    }
+    return seconds > 0 ? pixels * iterations / seconds / 1e6 : 0;
+}
+
+int main(int argc, char **argv) {
+    const int width = 1920;
+    const int height = 1080;
+    int iterations = argc > 1 ? atoi(argv[1]) : 100;
+
+    // Premultiplied, partly transparent pixels, like a real page.
+    std::vector<unsigned char> src(width * height * 4);
+    srand(1);
+    for (size_t i = 0; i < src.size(); i += 4) {
+        int a = (i / 4) % 7 ? 255 : rand() % 256;
+        src[i] = rand() % (a + 1);
+        src[i + 1] = rand() % (a + 1);
+        src[i + 2] = rand() % (a + 1);
+        src[i + 3] = a;
+    }
+
+    std::vector<Rect> full(1, makeRect(0, 0, width, height));
+    std::vector<Rect> dirty;
+    for (int i = 0; i < 32; ++i) {
+        dirty.push_back(makeRect(rand() % (width - 64), rand() % (height - 32),
+                                 17 + rand() % 47, 9 + rand() % 23));
+    }
+
+    printf("SIMD kernels: %s\n", PixelConvert::getKernelName());
+    printf("%-24s %14s %14s\n", "format", "full Mpix/s", "rects Mpix/s");
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+        std::vector<unsigned char> dest(
+            PixelConvert::getImageSize(formats[i].format, width, height));
+        double fullRate = run(formats[i].format, src, dest, width, height,
+                              full, iterations);
+        double dirtyRate = run(formats[i].format, src, dest, width, height,
+                               dirty, iterations * 100);
+        printf("%-24s %14.1f %14.1f\n", formats[i].name, fullRate, dirtyRate);
+    }
+    return 0;
+}
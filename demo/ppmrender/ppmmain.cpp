@@ -116,21 +116,9 @@ public:
         const int width = bitmap_rect.width();
         const int height = bitmap_rect.height();
 
+        // The window converts to RGB24, see setPaintFormat in main().
         fprintf(outfile, "P6 %d %d 255\n", width, height);
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                unsigned char r,g,b,a;
-		b = *(bitmap_in++);
-		g = *(bitmap_in++);
-		r = *(bitmap_in++);
-		a = *(bitmap_in++);
-                fputc(r, outfile);  // Red
-                //fputc(255-a, outfile);  // Alpha
-                fputc(g, outfile);  // Green
-                fputc(b, outfile);  // Blue
-                //(pixel >> 24) & 0xff;  // Alpha
-            }
-        }
+        fwrite(bitmap_in, 3, width * height, outfile);
         fclose(outfile);
     }
 
@@ -216,6 +204,7 @@ int main (int argc, char **argv) {
     delete context;
     win4->resize(800,600);
     win4->setDelegate(new TestDelegate);
+    win4->setPaintFormat(PIXEL_FORMAT_RGB24);
     if (argc < 2) {
         url="http://xkcd.com";
     } else {
@@ -0,0 +1,160 @@
+/*  Berkelium - Embedded Chromium
+ *  shmreader.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "berkelium/Berkelium.hpp"
+#include "berkelium/Window.hpp"
+#include "berkelium/Context.hpp"
+#include "berkelium/SharedFrame.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+
+using namespace Berkelium;
+
+// Renders a page into a shared memory export and reads it back from a
+// forked process, the way an out of process compositor would. The reader
+// checks every frame it uses with stillValid and saves the last one as a
+// PPM.
+
+static const int WIDTH = 800;
+static const int HEIGHT = 600;
+
+static bool writePPM(const char *filename,
+                     const SharedFrameReader::Frame &frame) {
+    FILE *out = fopen(filename, "wb");
+    if (!out) {
+        return false;
+    }
+    fprintf(out, "P6 %d %d 255\n", frame.width, frame.height);
+    for (int i = 0; i < frame.width * frame.height; ++i) {
+        const unsigned char *bgra = frame.pixels + i * 4;
+        unsigned char rgb[3] = {bgra[2], bgra[1], bgra[0]};
+        fwrite(rgb, 1, 3, out);
+    }
+    fclose(out);
+    return true;
+}
+
+static int runReader(const std::string &name) {
+    SharedFrameReader reader;
+    // The segment appears once the parent has started Berkelium.
+    for (int tries = 0; !reader.open(name.c_str()); ++tries) {
+        if (tries == 100) {
+            fprintf(stderr, "reader: %s never showed up\n", name.c_str());
+            return 1;
+        }
+        usleep(100000);
+    }
+    int last = 0;
+    int used = 0, torn = 0, skipped = 0;
+    SharedFrameReader::Frame frame;
+    while (reader.wait(last, -1)) {
+        if (!reader.acquire(&frame)) {
+            continue;
+        }
+        // A real consumer would upload frame.pixels here.
+        if (!reader.stillValid(frame)) {
+            ++torn;
+            continue;
+        }
+        if (last && frame.sequence != last + 1) {
+            skipped += frame.sequence - last - 1;
+        }
+        last = frame.sequence;
+        ++used;
+    }
+    printf("reader: used %d frames, %d torn, %d skipped\n",
+           used, torn, skipped);
+    // The mapping outlives the writer, so the last frame is still there.
+    if (reader.acquire(&frame) && writePPM("/tmp/shmreader.ppm", frame)) {
+        printf("reader: frame %d saved to /tmp/shmreader.ppm\n",
+               frame.sequence);
+    }
+    fflush(stdout);
+    return used ? 0 : 1;
+}
+
+int main (int argc, char **argv) {
+    std::string url = argc < 2 ? "http://xkcd.com" : argv[1];
+    int seconds = argc < 3 ? 10 : atoi(argv[2]);
+    char nameBuf[64];
+    snprintf(nameBuf, sizeof(nameBuf), "/berkelium-shmreader-%d",
+             (int)getpid());
+    std::string name(nameBuf);
+
+    // Before init, so the reader has none of Chromium's threads.
+    pid_t reader = fork();
+    if (reader == 0) {
+        _exit(runReader(name));
+    }
+
+    Berkelium::init(FileString::empty());
+    Context *context = Context::create();
+    std::auto_ptr<Window> win(Window::create(context));
+    delete context;
+    win->resize(WIDTH, HEIGHT);
+    if (!win->startSharedFrameExport(URLString::point_to(name),
+                                     WIDTH, HEIGHT, 3)) {
+        fprintf(stderr, "could not create %s\n", name.c_str());
+        kill(reader, SIGTERM);
+        return 1;
+    }
+    win->navigateTo(URLString::point_to(url));
+
+    time_t end = time(NULL) + seconds;
+    while (time(NULL) < end) {
+        Berkelium::update();
+        struct timeval tv;
+        tv.tv_sec = 0;
+        tv.tv_usec = 10000;
+        select(0, NULL, NULL, NULL, &tv);
+    }
+    // Wakes the reader up with the segment marked closed.
+    win->stopSharedFrameExport();
+    win.reset();
+    Berkelium::destroy();
+
+    int status = 0;
+    waitpid(reader, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -34,6 +34,7 @@
 #define _BERKELIUM_HPP_
 #include "berkelium/Platform.hpp"
 #include "berkelium/WeakString.hpp"
+#include "berkelium/Stats.hpp"
 namespace sandbox {
 class BrokerServices;
 class TargetServices;
@@ -43,6 +44,9 @@ enum DepEnforcement;
 }
 namespace Berkelium {
 
+class Window;
+class CaptureDelegate;
+
 /** May be implemented to handle global errors gracefully.
  */
 class BERKELIUM_EXPORT ErrorDelegate {
@@ -82,16 +86,57 @@ void BERKELIUM_EXPORT destroy();
 
 void BERKELIUM_EXPORT setErrorHandler(ErrorDelegate * errorHandler);
 
+/** Sets how many threads deliver paints for Windows using
+ *  Window::setThreadedPaint. Must be called before the first such Window.
+ *  \param numThreads  Thread count, or 0 (the default) for one per processor.
+ */
+void BERKELIUM_EXPORT setPaintThreads(int numThreads);
+
+/** Caps the memory used by the frame buffers of all Windows together.
+ *  When over the limit, the frame buffers of the least recently painted
+ *  hidden Windows (see Window::setVisible) are freed, and their
+ *  Window::getFrame returns NULL until they are shown again and repaint
+ *  completely. Visible Windows are never evicted.
+ * \param bytes  Limit in bytes, or 0 for none (the default).
+ */
+void BERKELIUM_EXPORT setFrameMemoryLimit(size_t bytes);
+
+/** Bytes currently held by the frame buffers of all Windows. */
+size_t BERKELIUM_EXPORT getFrameMemoryUsage();
+
+/** The clock input events are stamped with, in seconds. Use it for
+ *  InputEvent::timestamp.
+ */
+double BERKELIUM_EXPORT getInputTime();
+
+/** Paint counters summed over every Window and widget, including the ones
+ *  already destroyed. See Window::getPaintStats for a single page.
+ */
+PaintStats BERKELIUM_EXPORT getPaintStats();
+
 /** Runs the message loop until all pending messages are processed.
  *  Must be called from the same thread as all other Berkelium functions,
  *  usually your program's main (UI) thread.
  *  For now, you have to poll to receive updates without blocking indefinitely.
  *
  *  Your WindowDelegate's should only receive callbacks synchronously with
- *  this call to update.
+ *  this call to update, except for paints of Windows using
+ *  Window::setThreadedPaint.
  */
 void BERKELIUM_EXPORT update();
 
+/** Captures several Windows at once, running update() until every image
+ *  has been delivered to callback or timeoutMs has passed. Windows that
+ *  are not done by then are cancelled, see Window::cancelCapture.
+ *  \param windows  Windows to capture.
+ *  \param numWindows  Length of windows.
+ *  \param callback  Receives one onCapture per Window.
+ *  \param timeoutMs  Time limit in milliseconds, or 0 to wait forever.
+ *  \returns whether all images were complete.
+ */
+bool BERKELIUM_EXPORT captureAll(Window *const *windows, size_t numWindows,
+                                 CaptureDelegate *callback, int timeoutMs);
+
 }
 
 #endif
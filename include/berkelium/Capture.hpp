@@ -0,0 +1,77 @@
+/*  Berkelium - Embedded Chromium
+ *  Capture.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_CAPTURE_HPP_
+#define _BERKELIUM_CAPTURE_HPP_
+
+#include "berkelium/Platform.hpp"
+
+namespace Berkelium {
+
+class Window;
+class FrameBuffer;
+
+/** Timing and status of a capture, see Window::captureFrame. */
+struct CaptureInfo {
+    /** Whether every pixel of the image has been painted. False when the
+     *  capture was cancelled, timed out or the renderer crashed first.
+     */
+    bool complete;
+    /** Seconds from the request to this callback. */
+    double totalTime;
+    /** Part of totalTime spent waiting for the page to finish loading. */
+    double loadTime;
+    /** Number of page paints received while waiting. */
+    int numPaints;
+};
+
+/** Receives the images requested with Window::captureFrame or
+ *  Berkelium::captureAll.
+ */
+class BERKELIUM_EXPORT CaptureDelegate {
+public:
+    virtual ~CaptureDelegate() {}
+
+    /** An image of the whole page is ready.
+     * \param win  Window that was captured.
+     * \param frame  BGRA image of the page, only valid during this call.
+     *     NULL if nothing was ever painted.
+     * \param info  Whether the image is complete, and how long it took.
+     */
+    virtual void onCapture(Window *win, const FrameBuffer *frame,
+                           const CaptureInfo &info)=0;
+};
+
+}
+
+#endif
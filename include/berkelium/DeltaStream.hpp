@@ -0,0 +1,121 @@
+/*  Berkelium - Embedded Chromium
+ *  DeltaStream.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _BERKELIUM_DELTASTREAM_HPP_
+#define _BERKELIUM_DELTASTREAM_HPP_
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/Stats.hpp"
+
+namespace Berkelium {
+
+class FrameBuffer;
+class PaintFrame;
+
+/** Where a DeltaEncoder puts its stream: a socket, a file, a buffer. */
+class BERKELIUM_EXPORT DeltaSink {
+public:
+    virtual ~DeltaSink() {}
+
+    /** Called once per encoded paint with all of its bytes. */
+    virtual void write(const unsigned char *data, size_t length)=0;
+};
+
+/** Turns paints into a compact stream that a DeltaDecoder, typically in a
+ *  remote viewer, turns back into the exact same image of the page.
+ *
+ *  Scrolls are sent as a move of the pixels the viewer already has. The
+ *  copy rects are split into tiles on a grid of the view; each tile is
+ *  sent as a solid color, as a reference to an identical tile sent
+ *  earlier, or run length coded, falling back to raw pixels when that
+ *  doesn't help. The stream has no dependencies beyond this library and is
+ *  the same on every platform.
+ *
+ *  Feed it every paint of one page, in order, from
+ *  WindowDelegate::onPaintFrame.
+ */
+class BERKELIUM_EXPORT DeltaEncoder {
+protected:
+    DeltaEncoder() {}
+
+public:
+    /** \param sink  Receives the stream; must outlive the encoder.
+     * \param tileSize  Width and height of a tile, in pixels.
+     * \param cacheTiles  Number of recent tiles both sides remember, at
+     *     most 65535. Each costs tileSize * tileSize * 4 bytes on either
+     *     side.
+     */
+    static DeltaEncoder *create(DeltaSink *sink, int tileSize = 32,
+                                int cacheTiles = 1024);
+    virtual ~DeltaEncoder() {}
+
+    /** Encodes one paint and writes it to the sink. */
+    virtual void encode(const PaintFrame *frame)=0;
+
+    /** Starts over, for a new decoder. Paints only cover what changed,
+     *  so the new decoder also needs a full repaint of the page: hiding
+     *  and showing the Window with Window::setVisible brings one.
+     */
+    virtual void reset()=0;
+
+    virtual DeltaStats getStats() const=0;
+};
+
+/** Rebuilds the page from a DeltaEncoder stream. */
+class BERKELIUM_EXPORT DeltaDecoder {
+protected:
+    DeltaDecoder() {}
+
+public:
+    static DeltaDecoder *create();
+    virtual ~DeltaDecoder() {}
+
+    /** Applies the next bytes of the stream. They may be split anywhere;
+     *  an incomplete command waits for the rest.
+     * \returns false if the stream is corrupt, and for every call after.
+     */
+    virtual bool decode(const unsigned char *data, size_t length)=0;
+
+    /** The image as of the last complete command. */
+    virtual const FrameBuffer *getFrame() const=0;
+
+    /** Paints completely decoded so far. A viewer presents getFrame()
+     *  whenever this goes up.
+     */
+    virtual unsigned int getPaintsDecoded() const=0;
+};
+
+}
+
+#endif
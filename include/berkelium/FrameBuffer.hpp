@@ -0,0 +1,79 @@
+/*  Berkelium - Embedded Chromium
+ *  FrameBuffer.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_FRAMEBUFFER_HPP_
+#define _BERKELIUM_FRAMEBUFFER_HPP_
+
+#include "berkelium/Platform.hpp"
+
+namespace Berkelium {
+
+/** A persistent BGRA image of a whole Window, kept up to date by Berkelium
+ *  as paints arrive. Scrolls and copy rects have already been applied, so
+ *  every pixel is valid, unlike the buffer passed to
+ *  WindowDelegate::onPaint.
+ *
+ *  The contents only change inside Berkelium::update().
+ *  \see Window::setFrameBufferEnabled
+ */
+class BERKELIUM_EXPORT FrameBuffer {
+protected:
+    FrameBuffer() : mBuffer(NULL), mWidth(0), mHeight(0), mStride(0) {}
+    virtual ~FrameBuffer() {}
+
+public:
+    /** First row of the image. Rows are getStride() bytes apart. */
+    inline const unsigned char *getBuffer() const {
+        return mBuffer;
+    }
+    inline int getWidth() const {
+        return mWidth;
+    }
+    inline int getHeight() const {
+        return mHeight;
+    }
+    /** Distance in bytes between the start of two rows. */
+    inline size_t getStride() const {
+        return mStride;
+    }
+
+protected:
+    unsigned char *mBuffer;
+    int mWidth;
+    int mHeight;
+    size_t mStride;
+};
+
+}
+
+#endif
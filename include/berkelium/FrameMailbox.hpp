@@ -0,0 +1,69 @@
+/*  Berkelium - Embedded Chromium
+ *  FrameMailbox.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_FRAMEMAILBOX_HPP_
+#define _BERKELIUM_FRAMEMAILBOX_HPP_
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/Rect.hpp"
+
+namespace Berkelium {
+
+class FrameBuffer;
+
+/** Hands the frame of a Window to one other thread, see
+ *  Window::getFrameMailbox. The library keeps three copies of the frame:
+ *  the one the consumer holds, the latest published one and the one being
+ *  updated. Publishing and acquiring only swap them with an atomic
+ *  exchange, so neither side ever waits for the other.
+ */
+class BERKELIUM_EXPORT FrameMailbox {
+protected:
+    virtual ~FrameMailbox() {}
+
+public:
+    /** Takes the latest fully painted frame. The one from the previous
+     *  call goes back to the library, so only call this once done with it.
+     *  Only one thread may call this, but it can be any thread.
+     * \param numDirty  Receives the number of rects that changed since the
+     *     frame returned by the previous call.
+     * \param dirty  Receives those rects, valid until the next call.
+     * \returns the latest frame, or NULL if none was published yet. When
+     *     nothing new was published it is the same frame, with no rects.
+     */
+    virtual const FrameBuffer *acquire(size_t *numDirty, const Rect **dirty)=0;
+};
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*  Berkelium - Embedded Chromium
+ *  InputEvent.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _BERKELIUM_INPUTEVENT_HPP_
+#define _BERKELIUM_INPUTEVENT_HPP_
+
+#include "berkelium/Platform.hpp"
+
+namespace Berkelium {
+
+/** One event for Window::injectInput. Each type takes the same arguments
+ *  as the Window method of the same name.
+ */
+struct InputEvent {
+    enum Type {
+        MOUSE_MOVED,
+        MOUSE_BUTTON,
+        MOUSE_WHEEL,
+        KEY_EVENT,
+        TEXT_EVENT
+    };
+
+    struct MouseMoved {
+        int x;
+        int y;
+    };
+    struct MouseButton {
+        unsigned int buttonID;
+        bool down;
+    };
+    struct MouseWheel {
+        int xScroll;
+        int yScroll;
+    };
+    struct KeyEvent {
+        bool pressed;
+        /** Logical or of KeyModifiers. */
+        int mods;
+        int vk_code;
+        int scancode;
+    };
+    struct TextEvent {
+        /** Not copied; must stay valid during injectInput. */
+        const wchar_t *text;
+        size_t length;
+    };
+
+    Type type;
+    /** When the event happened, in seconds on the clock of
+     *  Berkelium::getInputTime(), or 0 for the time it is injected.
+     */
+    double timestamp;
+    union {
+        MouseMoved mouseMoved;
+        MouseButton mouseButton;
+        MouseWheel mouseWheel;
+        KeyEvent keyEvent;
+        TextEvent textEvent;
+    };
+};
+
+}
+
+#endif
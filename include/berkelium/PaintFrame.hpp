@@ -0,0 +1,133 @@
+/*  Berkelium - Embedded Chromium
+ *  PaintFrame.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_PAINTFRAME_HPP_
+#define _BERKELIUM_PAINTFRAME_HPP_
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/Rect.hpp"
+
+namespace Berkelium {
+
+/** A PaintFrame is a reference-counted handle to a single paint from the
+ *  renderer. The buffer points straight into the shared memory the renderer
+ *  painted into, so no copy is made to deliver it.
+ *
+ *  The renderer will not paint into that memory again until every reference
+ *  to the frame has been released, so keep a reference only as long as you
+ *  need the pixels. addRef() and release() may be called from any thread;
+ *  the acknowledgement which lets the renderer continue is always sent from
+ *  the thread that calls Berkelium::update().
+ *
+ *  A frame must not be used after the Window it came from is destroyed.
+ *
+ *  If the renderer crashes while a frame is held, its buffer is copied into
+ *  memory the frame owns before WindowDelegate::onCrashed is called, and
+ *  getBuffer() returns the copy from then on. The renderer's memory is
+ *  freed as soon as onCrashed returns, so a thread still reading through a
+ *  pointer it got from getBuffer() earlier must be done with it by then.
+ *  \see Window::setDeferredPaintAck
+ *  \see WindowDelegate::onPaintFrame
+ */
+class BERKELIUM_EXPORT PaintFrame {
+protected:
+    PaintFrame()
+        : mBuffer(NULL), mNumCopyRects(0), mCopyRects(NULL),
+          mDx(0), mDy(0), mViewWidth(0), mViewHeight(0) {
+        mBufferRect.mLeft = mBufferRect.mTop = 0;
+        mBufferRect.mWidth = mBufferRect.mHeight = 0;
+        mScrollRect = mBufferRect;
+    }
+    virtual ~PaintFrame() {}
+
+public:
+    /** Keeps the frame (and the renderer's buffer) alive. */
+    virtual void addRef()=0;
+    /** Drops a reference. When the last one goes away the renderer is
+     *  told it may reuse the buffer.
+     */
+    virtual void release()=0;
+
+    /** BGRA buffer with width/height of getBufferRect(). */
+    inline const unsigned char *getBuffer() const {
+        return mBuffer;
+    }
+    /** Rect containing the buffer, in view coordinates. */
+    inline const Rect &getBufferRect() const {
+        return mBufferRect;
+    }
+    /** Length of getCopyRects(). */
+    inline size_t getNumCopyRects() const {
+        return mNumCopyRects;
+    }
+    /** Array of valid+changed rectangles of the buffer, in view
+     *  coordinates. Anything outside of these is usually garbage data.
+     */
+    inline const Rect *getCopyRects() const {
+        return mCopyRects;
+    }
+    /** Horizontal scroll of getScrollRect() applied before this paint. */
+    inline int getDx() const {
+        return mDx;
+    }
+    /** Vertical scroll of getScrollRect() applied before this paint. */
+    inline int getDy() const {
+        return mDy;
+    }
+    /** Area of the page to scroll. Only valid if getDx() or getDy(). */
+    inline const Rect &getScrollRect() const {
+        return mScrollRect;
+    }
+    /** Size of the whole view this paint belongs to. */
+    inline int getViewWidth() const {
+        return mViewWidth;
+    }
+    inline int getViewHeight() const {
+        return mViewHeight;
+    }
+
+protected:
+    const unsigned char *mBuffer;
+    Rect mBufferRect;
+    size_t mNumCopyRects;
+    const Rect *mCopyRects;
+    int mDx;
+    int mDy;
+    Rect mScrollRect;
+    int mViewWidth;
+    int mViewHeight;
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*  Berkelium - Embedded Chromium
+ *  PixelConvert.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_PIXELCONVERT_HPP_
+#define _BERKELIUM_PIXELCONVERT_HPP_
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/Rect.hpp"
+
+namespace Berkelium {
+
+/** Pixel layouts PixelConvert can produce. Berkelium paints in
+ *  PIXEL_FORMAT_BGRA: bytes in B,G,R,A order with alpha premultiplied.
+ */
+enum PixelFormat {
+    PIXEL_FORMAT_BGRA,
+    PIXEL_FORMAT_BGRA_UNPREMULTIPLIED,
+    PIXEL_FORMAT_RGBA,
+    PIXEL_FORMAT_RGBA_UNPREMULTIPLIED,
+    /** R,G,B bytes, alpha dropped. */
+    PIXEL_FORMAT_RGB24,
+    /** Planar BT.601 YUV 4:2:0: a full size Y plane followed by U and V
+     *  planes of (width+1)/2 x (height+1)/2. Alpha is dropped.
+     */
+    PIXEL_FORMAT_I420
+};
+
+/** Converts the BGRA pixels Berkelium paints into other formats.
+ *  Destination images are tightly packed: rows of width*getBytesPerPixel()
+ *  bytes, or for I420 the three planes back to back.
+ *
+ *  Only the given rects are written, so a destination image can be kept up
+ *  to date from the dirty rects of each paint. Picks SSE2 or AVX2
+ *  kernels at load time from what the CPU supports.
+ */
+class BERKELIUM_EXPORT PixelConvert {
+public:
+    /** Bytes per pixel of a packed format, or 0 for I420. */
+    static int getBytesPerPixel(PixelFormat format);
+
+    /** Bytes needed for a width x height image in format. */
+    static size_t getImageSize(PixelFormat format, int width, int height);
+
+    /** Converts one area of a BGRA image.
+     * \param format  Destination format.
+     * \param src  BGRA source, width x height.
+     * \param srcStride  Distance in bytes between source rows.
+     * \param dest  Destination, getImageSize(format,width,height) bytes.
+     * \param width  Width of both images.
+     * \param height  Height of both images.
+     * \param rect  Area to convert; clipped to the image. For I420 the
+     *     chroma samples touching rect are rewritten from the pixels inside
+     *     rect only, so pixels outside of it are never read.
+     */
+    static void convert(PixelFormat format,
+                        const unsigned char *src, size_t srcStride,
+                        unsigned char *dest, int width, int height,
+                        const Rect &rect);
+
+    /** Converts each of rects, see the single rect version. */
+    static void convert(PixelFormat format,
+                        const unsigned char *src, size_t srcStride,
+                        unsigned char *dest, int width, int height,
+                        size_t numRects, const Rect *rects);
+
+    /** Whether SIMD kernels were built and the CPU runs them. */
+    static bool isAccelerated();
+
+    /** Name of the kernel set in use: "AVX2", "SSE2" or "scalar". */
+    static const char *getKernelName();
+};
+
+}
+
+#endif
@@ -0,0 +1,271 @@
+/*  Berkelium - Embedded Chromium
+ *  SharedFrame.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _BERKELIUM_SHAREDFRAME_HPP_
+#define _BERKELIUM_SHAREDFRAME_HPP_
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/Rect.hpp"
+
+#if BERKELIUM_PLATFORM != PLATFORM_WINDOWS
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if BERKELIUM_PLATFORM == PLATFORM_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Berkelium {
+
+/** Layout of the shared memory written by Window::startSharedFrameExport,
+ *  and a reader for it that needs nothing but this header.
+ *
+ *  The segment starts with a SharedFrameHeader, followed by numSlots
+ *  SharedFrameSlots, followed by the pixels of each slot at pixelOffset +
+ *  slot * slotBytes. Pixels are BGRA, premultiplied, width * 4 bytes per
+ *  row, like FrameBuffer.
+ *
+ *  The writer fills the slots round robin and never waits for readers.
+ *  Each slot is guarded by a sequence lock: lock is odd while the slot is
+ *  being written, so a reader checks that it is even and unchanged after
+ *  it is done with the pixels.
+ */
+struct SharedFrameHeader {
+    enum {
+        MAGIC = 0x464b4542, // "BEKF"
+        VERSION = 2,
+        MAX_DIRTY_RECTS = 32
+    };
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numSlots;
+    uint32_t slotBytes;
+    uint32_t pixelOffset;
+    int32_t maxWidth;
+    int32_t maxHeight;
+    /// Slot holding the frame with sequence published.
+    volatile uint32_t latestSlot;
+    /// Sequence of the latest frame, 0 for none. Readers can futex wait
+    /// on it.
+    volatile int32_t published;
+    /// Set once the writer is gone.
+    volatile int32_t closed;
+    /// Process of the writer, so a new one can tell whether a segment
+    /// left under the same name is still in use.
+    int32_t writerPid;
+};
+
+struct SharedFrameSlot {
+    volatile uint32_t lock;
+    int32_t sequence;
+    int32_t width;
+    int32_t height;
+    /// What changed since the frame with sequence - 1. Readers that
+    /// skipped frames should treat the whole frame as changed.
+    uint32_t numDirty;
+    Rect dirty[SharedFrameHeader::MAX_DIRTY_RECTS];
+};
+
+/** Maps a segment written by Window::startSharedFrameExport read only,
+ *  possibly from another process. Frames are used in place:
+ *  \code
+ *  SharedFrameReader reader;
+ *  reader.open("/myframes");
+ *  int last = 0;
+ *  SharedFrameReader::Frame frame;
+ *  while (reader.wait(last, 1000)) {
+ *      if (reader.acquire(&frame)) {
+ *          upload(frame.pixels, frame.width, frame.height);
+ *          if (reader.stillValid(frame)) {
+ *              last = frame.sequence;
+ *          }
+ *      }
+ *  }
+ *  \endcode
+ */
+class SharedFrameReader {
+public:
+    struct Frame {
+        const unsigned char *pixels;
+        int width;
+        int height;
+        int sequence;
+        /// See SharedFrameSlot::dirty.
+        size_t numDirty;
+        const Rect *dirty;
+
+        // For stillValid.
+        uint32_t slot;
+        uint32_t lock;
+    };
+
+    SharedFrameReader() : mBase(NULL), mSize(0) {
+    }
+    ~SharedFrameReader() {
+        close();
+    }
+
+    /** Maps the segment with the given name, as passed to
+     *  Window::startSharedFrameExport.
+     * \returns false if it does not exist or is not a frame export.
+     */
+    bool open(const char *name) {
+        close();
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        void *base = MAP_FAILED;
+        if (fstat(fd, &st) == 0 &&
+            (size_t)st.st_size >= sizeof(SharedFrameHeader)) {
+            base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            return false;
+        }
+        mBase = static_cast<const unsigned char*>(base);
+        mSize = st.st_size;
+        const SharedFrameHeader *head = header();
+        if (head->magic != SharedFrameHeader::MAGIC ||
+            head->version != SharedFrameHeader::VERSION ||
+            head->pixelOffset + (size_t)head->numSlots * head->slotBytes >
+                mSize) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (mBase) {
+            munmap(const_cast<unsigned char*>(mBase), mSize);
+            mBase = NULL;
+            mSize = 0;
+        }
+    }
+
+    const SharedFrameHeader *header() const {
+        return reinterpret_cast<const SharedFrameHeader*>(mBase);
+    }
+
+    /** Blocks until a frame after sequence is published.
+     * \param timeoutMs  Longest time to wait, or -1 for no limit.
+     * \returns false on timeout or once the writer has stopped.
+     */
+    bool wait(int sequence, int timeoutMs) {
+        const SharedFrameHeader *head = header();
+        struct timespec step;
+        step.tv_sec = 0;
+        step.tv_nsec = 1000000;
+        int waited = 0;
+        while (head->published == sequence) {
+            if (head->closed || (timeoutMs >= 0 && waited >= timeoutMs)) {
+                return false;
+            }
+#if BERKELIUM_PLATFORM == PLATFORM_LINUX
+            // Wakes up when the writer publishes, or after at most step.
+            syscall(SYS_futex, &head->published, FUTEX_WAIT, sequence,
+                    &step, NULL, 0);
+#else
+            nanosleep(&step, NULL);
+#endif
+            ++waited;
+        }
+        return !head->closed;
+    }
+
+    /** Finds the latest frame.
+     * \returns false if none was published yet, or the writer was in the
+     *     middle of replacing it; try again then.
+     */
+    bool acquire(Frame *frame) const {
+        const SharedFrameHeader *head = header();
+        if (head->published == 0) {
+            return false;
+        }
+        __sync_synchronize();
+        uint32_t slot = head->latestSlot;
+        if (slot >= head->numSlots) {
+            return false;
+        }
+        const SharedFrameSlot *info = slotInfo(slot);
+        frame->lock = info->lock;
+        __sync_synchronize();
+        if (frame->lock & 1) {
+            return false;
+        }
+        frame->slot = slot;
+        frame->width = info->width;
+        frame->height = info->height;
+        frame->sequence = info->sequence;
+        frame->numDirty = info->numDirty;
+        if (frame->numDirty > SharedFrameHeader::MAX_DIRTY_RECTS) {
+            return false;
+        }
+        frame->dirty = info->dirty;
+        frame->pixels = mBase + head->pixelOffset +
+            (size_t)slot * head->slotBytes;
+        return stillValid(*frame);
+    }
+
+    /** Whether the writer left the frame alone since acquire. Check it
+     *  after reading the pixels; if false they may be torn.
+     */
+    bool stillValid(const Frame &frame) const {
+        __sync_synchronize();
+        return slotInfo(frame.slot)->lock == frame.lock;
+    }
+
+private:
+    const SharedFrameSlot *slotInfo(uint32_t slot) const {
+        return reinterpret_cast<const SharedFrameSlot*>(
+            mBase + sizeof(SharedFrameHeader)) + slot;
+    }
+
+    const unsigned char *mBase;
+    size_t mSize;
+};
+
+}
+
+#endif
+
+#endif
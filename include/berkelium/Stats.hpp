@@ -0,0 +1,176 @@
+/*  Berkelium - Embedded Chromium
+ *  Stats.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_STATS_HPP_
+#define _BERKELIUM_STATS_HPP_
+
+namespace Berkelium {
+
+/** Counters for Window::resize, see Window::getResizeStats. Latencies are
+ *  in seconds, from sending a size to the renderer until the first paint
+ *  at that size.
+ */
+struct ResizeStats {
+    /** Calls to Window::resize. */
+    unsigned int requested;
+    /** Requests replaced by a newer size before they were sent. */
+    unsigned int coalesced;
+    /** Sizes sent to the renderer. */
+    unsigned int sent;
+    /** Sizes the renderer has painted at. */
+    unsigned int acked;
+    double lastLatency;
+    double maxLatency;
+    /** Sum of all latencies; divide by acked for the mean. */
+    double totalLatency;
+};
+
+/** Counters for a recording, see Window::startRecording. */
+struct RecordStats {
+    /** Frames handed to the writer thread. */
+    unsigned int queued;
+    /** Frames written to the file. */
+    unsigned int written;
+    /** Frames lost: sampling times missed because update() wasn't called
+     *  in time, samples taken while every buffer was still waiting to be
+     *  written, and failed writes.
+     */
+    unsigned int dropped;
+};
+
+/** Counters for a DeltaEncoder. Tiles are counted by how they were sent.
+ */
+struct DeltaStats {
+    unsigned int paints;
+    unsigned int scrolls;
+    unsigned int solidTiles;
+    unsigned int cachedTiles;
+    unsigned int runLengthTiles;
+    unsigned int rawTiles;
+    /** Size of the stream. */
+    double bytesWritten;
+    /** What the copied pixels alone would have taken. */
+    double pixelBytes;
+};
+
+/** Counters for the paints coming from a renderer, see Window::getPaintStats
+ *  and Berkelium::getPaintStats. Byte and pixel totals are doubles so they
+ *  don't wrap on long running pages.
+ */
+struct PaintStats {
+    enum {
+        /** Number of entries in ackLatency. */
+        ACK_BUCKETS = 12
+    };
+    /** UpdateRect messages received from the renderer. */
+    unsigned int updateRects;
+    /** Copy rects passed on, after the damage filter. */
+    unsigned int copyRects;
+    /** Paints passed on that included a scroll. */
+    unsigned int scrolls;
+    /** Pixels covered by the copy rects passed on. */
+    double pixels;
+    /** Bytes of bitmap the renderer copied into shared memory. */
+    double bytesCopied;
+    /** Seconds spent handling paints on the thread that received them,
+     *  which includes the delegate callbacks unless paints are threaded.
+     */
+    double delegateTime;
+    /** Time from receiving an UpdateRect until it was acknowledged.
+     *  Bucket 0 counts ACKs under 1 ms, bucket i those under 2^i ms and
+     *  the last one everything slower.
+     */
+    unsigned int ackLatency[ACK_BUCKETS];
+};
+
+/** Results of Window::startInputReplay. Latencies are in seconds, from
+ *  injecting an event until the next paint of the page.
+ */
+struct InputReplayStats {
+    /** Events in the log. */
+    unsigned int events;
+    unsigned int injected;
+    /** Injected events painted after the renderer acknowledged them. */
+    unsigned int painted;
+    /** Injected events no paint followed before the replay ended. */
+    unsigned int unpainted;
+    double maxLatency;
+    /** Sum of all latencies; divide by painted for the mean. */
+    double totalLatency;
+};
+
+/** Time from an input method call on the Window until the paint that
+ *  followed the renderer's ACK of that event reached the delegate, see
+ *  Window::getInputLatencyStats. Latencies are in seconds; percentiles
+ *  are over the last 1024 painted events.
+ */
+struct InputLatencyStats {
+    /** Events sent to a renderer. Coalesced ones are not counted. */
+    unsigned int events;
+    /** Events followed by a paint after their ACK. */
+    unsigned int painted;
+    /** Events not painted within a second of their ACK, or lost with
+     *  their renderer.
+     */
+    unsigned int unpainted;
+    double p50;
+    double p90;
+    double p99;
+    double maxLatency;
+};
+
+/** Counters for the input sent to a page and its widgets, see
+ *  Window::getInputStats.
+ */
+struct InputStats {
+    /** Mouse moves passed to the Window. */
+    unsigned int mouseMoves;
+    /** Mouse moves replaced by a later one before they were sent. */
+    unsigned int movesCoalesced;
+    /** Wheel events passed to the Window. */
+    unsigned int wheels;
+    /** Wheel events added into a later one before they were sent. */
+    unsigned int wheelsCoalesced;
+    /** Events of any kind sent on to the renderer. */
+    unsigned int sent;
+    /** Input ACKs from the renderer. */
+    unsigned int acked;
+    /** Text events committed in one piece, see
+     *  Window::setTextInsertThreshold. These are not counted in sent.
+     */
+    unsigned int textInserts;
+};
+
+}
+
+#endif
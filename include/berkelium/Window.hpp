@@ -36,12 +36,18 @@
 #include <vector>
 
 #include "berkelium/WeakString.hpp"
+#include "berkelium/PixelConvert.hpp"
+#include "berkelium/Stats.hpp"
+#include "berkelium/InputEvent.hpp"
 
 namespace Berkelium {
 
 class Widget;
 class WindowDelegate;
 class Context;
+class FrameBuffer;
+class CaptureDelegate;
+class FrameMailbox;
 
 namespace Script{
 class Variant;
@@ -57,6 +63,34 @@ enum KeyModifier {
     SYSTEM_KEY     = 1 << 6 // if the keypress is a system event (WM_SYS* messages in windows)
 };
 
+/** File formats for Window::startRecording. */
+enum RecordFormat {
+    /** YUV4MPEG2 with 4:2:0 BT.601 frames. Each FRAME header carries its
+     *  time since the first frame as Xts=<microseconds>.
+     */
+    RECORD_Y4M,
+    /** Tightly packed BGRA frames back to back. The size, rate and frame
+     *  times go into a text file next to it, with ".timestamps" appended.
+     */
+    RECORD_RAW_BGRA
+};
+
+/** Cost model used to merge the dirty rects reported by
+ *  WindowDelegate::onFrameUpdated, see Window::setPaintCoalescing.
+ */
+struct PaintCoalescing {
+    /** What handling one more rect costs the embedder (a texture upload,
+     *  a draw call...), measured in pixels. Two rects are merged when their
+     *  bounding box adds fewer pixels than this. Rects that are contained
+     *  in or exactly adjacent to another are always merged.
+     */
+    int perRectCost;
+    /** Upper bound on the number of rects per update, or 0 for no limit.
+     *  The cheapest merges are made until the list fits.
+     */
+    int maxRects;
+};
+
 /** Windows are individual web pages, the equivalent of a single tab in a normal
  *  browser.  Windows mediate interaction between the user and the
  *  renderer. They allow inspection of the page (access to UI widgets),
@@ -168,6 +202,230 @@ public:
      */
     virtual void setTransparent(bool istrans)=0;
 
+    /** Switches paint delivery to WindowDelegate::onPaintFrame and
+     *  onWidgetPaintFrame. Instead of copying the buffer before returning,
+     *  the delegate may keep a reference to the PaintFrame and read the
+     *  pixels in place, possibly from another thread. The renderer is held
+     *  back until the frame is released.
+     *  Defaults to false, where the buffer passed to onPaint is only valid
+     *  for the duration of the call.
+     * \param deferred  Whether paint acknowledgements wait for the frame.
+     */
+    virtual void setDeferredPaintAck(bool deferred)=0;
+
+    /** Makes Berkelium keep a complete copy of the page, with scrolls and
+     *  copy rects already applied, so embedders don't have to rebuild the
+     *  frame from onPaint. Changes are reported through
+     *  WindowDelegate::onFrameUpdated. Widgets are not included.
+     *  Enabling it requests a full repaint of the page.
+     *  Defaults to false.
+     * \param enabled  Whether to maintain the frame buffer.
+     */
+    virtual void setFrameBufferEnabled(bool enabled)=0;
+
+    /** The frame kept by setFrameBufferEnabled, or NULL if it is off.
+     *  Also NULL while the Window is hidden and its frame buffer was
+     *  evicted by Berkelium::setFrameMemoryLimit, until setVisible(true)
+     *  brings it back.
+     *  The pointer stays valid until the frame buffer is disabled or
+     *  evicted, or the Window is destroyed; the contents only change
+     *  inside update().
+     */
+    virtual const FrameBuffer* getFrame() const=0;
+
+    /** Sets how the dirty rects passed to WindowDelegate::onFrameUpdated
+     *  are merged before delivery. The frame buffer holds valid pixels
+     *  everywhere, so merged rects may safely cover unchanged areas.
+     *  Defaults to {0, 0}: only merges that add no pixels.
+     * \param policy  Cost model to use.
+     */
+    virtual void setPaintCoalescing(const PaintCoalescing &policy)=0;
+
+    /** Limits how often the page is painted. A paint that arrives sooner
+     *  than 1/fps seconds after the previous one is held back until the
+     *  interval is over, and the renderer is not acknowledged meanwhile, so
+     *  it folds everything that changes in between into its next paint
+     *  instead of rendering frames nobody sees. Widgets are not limited.
+     *  Defaults to 0, no limit.
+     * \param fps  Maximum paints per second, or 0 to disable.
+     */
+    virtual void setMaxFrameRate(int fps)=0;
+
+    /** Sets the pixel format of the buffer passed to WindowDelegate::onPaint
+     *  and onWidgetPaint. Only the copy rects are converted; the buffer is
+     *  laid out as described in PixelConvert, with the size of the source
+     *  buffer rect. PaintFrames and the frame buffer always stay BGRA;
+     *  the default WindowDelegate::onPaintFrame converts before calling
+     *  onPaint.
+     *  Defaults to PIXEL_FORMAT_BGRA, which hands out the renderer's buffer
+     *  without any conversion.
+     * \param format  Format to convert paints to.
+     */
+    virtual void setPaintFormat(PixelFormat format)=0;
+
+    /** Drops the parts of each paint whose pixels are identical to what
+     *  was last painted there, such as a caret blinking back or a looping
+     *  animation. The page is hashed in square tiles; copy rects shrink to
+     *  the tiles that changed, and a paint with nothing left and no scroll
+     *  is not delivered at all. Costs one pass over the painted pixels.
+     *  Widgets are not filtered. Defaults to off.
+     * \param enabled  Whether to filter paints.
+     * \param tileSize  Edge of a tile in pixels; 64 if not positive.
+     */
+    virtual void setDamageFilter(bool enabled, int tileSize)=0;
+
+    /** Delivers onPaint, onPaintFrame, onWidgetPaint and onWidgetPaintFrame
+     *  on a Berkelium paint thread instead of inside update(), so slow
+     *  delegates don't hold up other Windows. Paints of one Window still
+     *  arrive in order, one at a time; different Windows paint in parallel.
+     *  The renderer is acknowledged once the callback returns (or the
+     *  PaintFrame is released), so a slow delegate only slows its own page.
+     *  All other callbacks, including onFrameUpdated, stay in update(), so
+     *  they may arrive before the onPaint of the same paint.
+     *  Turning it off, destroying the Window or a renderer crash drops
+     *  paints still queued and waits for the one being delivered; a paint
+     *  callback must not wait for the thread calling update() in the
+     *  meantime. After a crash, a full repaint is requested once the new
+     *  renderer is up.
+     *  Defaults to false.
+     *  \see Berkelium::setPaintThreads
+     * \param threaded  Whether to paint from a paint thread.
+     */
+    virtual void setThreadedPaint(bool threaded)=0;
+
+    /** Requests one complete image of the page. Once the page has stopped
+     *  loading and every pixel has been painted, a repaint is forced if
+     *  needed, and callback->onCapture is called from update() with the
+     *  image. If the frame is already complete the callback happens
+     *  before captureFrame returns. Hidden windows don't paint, so on a
+     *  window hidden with setVisible(false) the callback also happens
+     *  right away, with whatever the frame holds; hiding a window fails
+     *  its pending captures the same way. Widgets are not included.
+     *  \see Berkelium::captureAll for a blocking version.
+     * \param callback  Receives the image. Must stay alive until then.
+     */
+    virtual void captureFrame(CaptureDelegate *callback)=0;
+
+    /** Gives up on the captures requested with callback: onCapture is
+     *  called right away with whatever has been painted, marked incomplete.
+     */
+    virtual void cancelCapture(CaptureDelegate *callback)=0;
+
+    /** Counters and ack latencies of resize(); see also
+     *  WindowDelegate::onResizeComplete.
+     */
+    virtual ResizeStats getResizeStats() const=0;
+
+    /** Paint counters for this page since it was created. Widgets only
+     *  count towards Berkelium::getPaintStats.
+     */
+    virtual PaintStats getPaintStats() const=0;
+
+    /** Keeps downscaled copies of the page: level 1 is half size, 2 is a
+     *  quarter and 3 an eighth, each box filtered from the one above. Only
+     *  the areas under each paint's dirty rects are recomputed, and the
+     *  result is reported with WindowDelegate::onThumbnailUpdated.
+     *  Widgets are not included. Enabling it requests a full repaint.
+     * \param level  Smallest level to maintain, 1 to 3, or 0 to turn
+     *     thumbnails off (the default).
+     */
+    virtual void setThumbnailLevel(int level)=0;
+
+    /** Thumbnail at level, up to the one chosen with setThumbnailLevel,
+     *  or NULL. Only changes inside update().
+     */
+    virtual const FrameBuffer* getThumbnail(int level) const=0;
+
+    /** Limits page paints sent to the delegate to the given areas. Copy
+     *  rects are clipped to them, scrolls outside them are dropped, and a
+     *  paint that changed nothing inside them is not delivered at all. A
+     *  scroll that would move pixels from outside into them is dropped
+     *  too, and replaced by a full repaint.
+     *  The frame buffer, thumbnails and captures still see the whole
+     *  page. Growing the region requests a full repaint, since the new
+     *  parts were never sent. Widgets are not affected.
+     * \param rects  Areas in page coordinates; copied.
+     * \param numRects  0 to receive paints for the whole page again.
+     */
+    virtual void setPaintInterest(const Rect *rects, size_t numRects)=0;
+
+    /** Draws popup widgets over the page inside the library, so onPaint
+     *  always shows the whole view as the user would see it. Widget paints,
+     *  moves and removals come out as page paints covering what changed,
+     *  and onWidgetPaint is no longer called. Composited paints are
+     *  delivered with onPaint on the update() thread, in the setPaintFormat
+     *  format and without scrolls; setDeferredPaintAck, setThreadedPaint
+     *  and setPaintInterest don't apply to them.
+     *  Enabling it requests a full repaint of the page and its widgets.
+     */
+    virtual void setWidgetCompositing(bool enabled)=0;
+
+    /** Hides or shows the page and its widgets. A hidden renderer stops
+     *  painting, and its process is given a lower priority once all of its
+     *  windows are hidden. Showing it again brings one full repaint.
+     *  Hidden windows may lose their frame buffer to
+     *  Berkelium::setFrameMemoryLimit until then.
+     *  Windows start out visible.
+     */
+    virtual void setVisible(bool visible)=0;
+
+    /** Records the page to a file. The frame buffer is sampled fps times a
+     *  second from update() and copied into one of bufferFrames
+     *  preallocated buffers, which a background thread converts and
+     *  writes. Sampling starts once the page is fully painted, and the
+     *  size of the first frame is kept: later frames are cropped or padded
+     *  with black. Widgets are not recorded.
+     * \param filename  File to create; an existing one is replaced.
+     * \param format  What to write, see RecordFormat.
+     * \param fps  Frames per second.
+     * \param bufferFrames  Frames that can wait for the writer before
+     *     samples are dropped.
+     * \returns false if already recording or the file can't be created.
+     */
+    virtual bool startRecording(FileString filename, RecordFormat format,
+                                int fps, int bufferFrames)=0;
+
+    /** Waits for the queued frames to be written and closes the file.
+     * \returns the final counters, all 0 if not recording.
+     */
+    virtual RecordStats stopRecording()=0;
+
+    /** Counters of the recording in progress, all 0 if not recording. */
+    virtual RecordStats getRecordStats() const=0;
+
+    /** Publishes every fully painted frame of the page to a mailbox that
+     *  another thread can take it from, see FrameMailbox. Created by the
+     *  first call, which needs the frame buffer and requests a full
+     *  repaint if it was off. The same mailbox is returned until the
+     *  Window is destroyed. Widgets are not included.
+     */
+    virtual FrameMailbox *getFrameMailbox()=0;
+
+    /** Writes every fully painted frame of the page into a named POSIX
+     *  shared memory ring, for a process that maps it read only with
+     *  SharedFrameReader. Readers are woken through a futex on Linux and
+     *  poll elsewhere. Needs the frame buffer, and requests a full repaint
+     *  if it was off. Replaces a previous export. Not available on
+     *  Windows.
+     * \param name  Name for shm_open, such as "/myapp-frames".
+     * \param maxWidth  Largest frame width to export; the segment is
+     *     sized for it up front. Larger frames are skipped.
+     * \param maxHeight  Largest frame height to export.
+     * \param numSlots  Frames kept in the ring. A reader has until the
+     *     writer comes back around to use a frame, so more slots give
+     *     slow readers more time.
+     * \returns false if the segment couldn't be created, or name is
+     *     still in use by a live writer. A segment left behind by a
+     *     writer that died is replaced.
+     */
+    virtual bool startSharedFrameExport(URLString name, int maxWidth,
+                                        int maxHeight, int numSlots)=0;
+
+    /** Stops the export and unlinks the segment. Readers still mapping it
+     *  see it marked closed.
+     */
+    virtual void stopSharedFrameExport()=0;
+
     /** Set the topmost Widget for this Window as focused.
      */
     virtual void focus()=0;
@@ -208,6 +466,87 @@ public:
      */
     virtual void keyEvent(bool pressed, int mods, int vk_code, int scancode)=0;
 
+    /** Injects a batch of input events, in order, as if each had been
+     *  passed to the method of the same name but stamped with its own
+     *  time. Widgets are looked up once for the batch rather than once
+     *  per event, which adds up when replaying thousands of events.
+     *  \param events  Events to inject.
+     *  \param numEvents  Length of events.
+     */
+    virtual void injectInput(const InputEvent *events, size_t numEvents)=0;
+
+    /** While the renderer hasn't acknowledged every input event, holds
+     *  back mouse moves and wheel events: consecutive moves collapse into
+     *  the latest position, and consecutive wheel events add up. They are
+     *  sent once the renderer is ready, or right before any other input
+     *  so that order is kept. On by default.
+     */
+    virtual void setInputCoalescing(bool enabled)=0;
+
+    /** Text at least this long (in UTF-16 code units) is committed to the
+     *  focused element in one operation, like an IME would, instead of one
+     *  key event per character. The page sees a single textInput event and
+     *  lays out once, but no keydown/keypress events, so only enable it
+     *  for pages that don't rely on them. Defaults to 0, which always
+     *  sends key events.
+     *  \param length  Threshold in UTF-16 code units, or 0 to disable.
+     */
+    virtual void setTextInsertThreshold(size_t length)=0;
+
+    /** Counters of the input sent to the page and its widgets. */
+    virtual InputStats getInputStats() const=0;
+
+    /** Time from each input method call until the paint that shows its
+     *  effect reached the delegate. An event is matched with the first
+     *  paint of its widget that the renderer sent after acknowledging it.
+     */
+    virtual InputLatencyStats getInputLatencyStats() const=0;
+
+    /** Writes one line per input event to a text file as its latency is
+     *  known: its id, type, and the times it came in, was acknowledged
+     *  and was painted, with "-" for what never happened. Replaces a
+     *  previous trace.
+     * \returns false if the file couldn't be created.
+     */
+    virtual bool startInputLatencyTrace(FileString filename)=0;
+
+    /** Closes the trace. */
+    virtual void stopInputLatencyTrace()=0;
+
+    /** Logs every call to the input methods above, injectInput included,
+     *  with the time between them, to a compact binary file that
+     *  startInputReplay can play back. Replaces a previous recording.
+     * \returns false if the file couldn't be created.
+     */
+    virtual bool startInputRecording(FileString filename)=0;
+
+    /** Closes the log. */
+    virtual void stopInputRecording()=0;
+
+    /** Plays back a log from startInputRecording into this Window, driven
+     *  by Berkelium::update(). For each event, the time until the paint
+     *  after the renderer acknowledged it goes to
+     *  WindowDelegate::onInputReplayed; an event merged into a later one
+     *  by setInputCoalescing shares that one's acknowledgement. Events
+     *  that were dropped, or had no paint soon after, count as unpainted.
+     *  Once every event was injected and painted or unpainted, or a second
+     *  passed after the last one, WindowDelegate::onInputReplayDone is
+     *  called. Replaces a replay in progress.
+     * \param filename  Log to play.
+     * \param speed  1 for the recorded pace, 2 for twice as fast, and so
+     *     on; 0 injects everything at once.
+     * \returns false if the log couldn't be read.
+     */
+    virtual bool startInputReplay(FileString filename, double speed)=0;
+
+    /** Stops injecting; events still waiting for a paint count as
+     *  unpainted. No onInputReplayDone is sent.
+     */
+    virtual void stopInputReplay()=0;
+
+    /** Results of the current or last replay. */
+    virtual InputReplayStats getInputReplayStats() const=0;
+
 
     /** Resize the Window. You should receive an onPaint message as an
      *  acknowledgement.
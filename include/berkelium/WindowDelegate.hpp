@@ -35,6 +35,8 @@
 
 #include "berkelium/WeakString.hpp"
 #include "berkelium/Rect.hpp"
+#include "berkelium/PaintFrame.hpp"
+#include "berkelium/FrameBuffer.hpp"
 #include "berkelium/ScriptVariant.hpp"
 #include "berkelium/Window.hpp"
 
@@ -125,6 +127,34 @@ public:
      * \param win  Window instance that fired this event.
      */
     virtual void onLoad(Window *win) {}
+    /**
+     * The renderer has painted at a size requested with Window::resize.
+     * Sizes replaced by a later resize before reaching the renderer are
+     * skipped, so only the sizes actually rendered are reported.
+     *
+     * \param win  Window instance that fired this event.
+     * \param width  New width of the page.
+     * \param height  New height of the page.
+     * \param latency  Seconds between sending the size and this paint.
+     */
+    virtual void onResizeComplete(Window *win, int width, int height,
+                                  double latency) {}
+    /**
+     * The renderer handled an event from Window::startInputReplay, and
+     * the paint after it was delivered.
+     *
+     * \param win  Window instance that fired this event.
+     * \param eventIndex  Position of the event in the log, from 0.
+     * \param latency  Seconds from injecting the event until that paint.
+     */
+    virtual void onInputReplayed(Window *win, size_t eventIndex,
+                                 double latency) {}
+    /**
+     * A replay has ended, see Window::getInputReplayStats for the results.
+     *
+     * \param win  Window instance that fired this event.
+     */
+    virtual void onInputReplayDone(Window *win) {}
     /**
      * A worker has crashed. No info is provided yet to the callback.
      *
@@ -289,7 +319,8 @@ public:
      * into application (video) memory before returning.
      *
      * \param win  Window instance that fired this event.
-     * \param sourceBuffer  BGRA buffer with width/height of sourceBufferRect.
+     * \param sourceBuffer  Buffer with width/height of sourceBufferRect, BGRA
+     *     unless changed with Window::setPaintFormat.
      * \param sourceBufferRect  Rect containing the buffer.
      * \param numCopyRects  Length of copyRects.
      * \param copyRects  Array of valid+changed rectangles of sourceBuffer.
@@ -311,6 +342,50 @@ public:
         int dx, int dy,
         const Rect &scrollRect) {}
 
+    /**
+     * The window is being painted and Window::setDeferredPaintAck is on.
+     * Call frame->addRef() to keep reading the renderer's buffer after
+     * returning, and frame->release() once done with it; the renderer won't
+     * paint again until then.
+     * The frame's buffer is always BGRA. The default implementation
+     * forwards to onPaint, converting to the Window::setPaintFormat format
+     * first, and acknowledges the paint once it returns.
+     *
+     * \param win  Window instance that fired this event.
+     * \param frame  Handle to the buffer and rects, see onPaint.
+     */
+    virtual void onPaintFrame(Window *win, PaintFrame *frame);
+
+    /**
+     * The frame kept by Window::setFrameBufferEnabled has changed. Called
+     * after onPaint for the same paint, unless Window::setThreadedPaint
+     * moved onPaint to a paint thread; then the two are not ordered.
+     *
+     * \param win  Window instance that fired this event.
+     * \param frame  Up to date image of the whole page.
+     * \param numDirtyRects  Length of dirtyRects.
+     * \param dirtyRects  Areas of frame which changed, possibly overlapping.
+     */
+    virtual void onFrameUpdated(Window *win, const FrameBuffer *frame,
+                                size_t numDirtyRects,
+                                const Rect *dirtyRects) {}
+
+    /**
+     * The thumbnail chosen with Window::setThumbnailLevel has changed.
+     * Called after onFrameUpdated for the same paint, and after onPaint
+     * unless Window::setThreadedPaint is on.
+     *
+     * \param win  Window instance that fired this event.
+     * \param level  Level of thumbnail, see Window::setThumbnailLevel.
+     * \param thumbnail  Up to date, downscaled image of the whole page.
+     * \param numDirtyRects  Length of dirtyRects.
+     * \param dirtyRects  Areas of thumbnail which changed.
+     */
+    virtual void onThumbnailUpdated(Window *win, int level,
+                                    const FrameBuffer *thumbnail,
+                                    size_t numDirtyRects,
+                                    const Rect *dirtyRects) {}
+
     /**
      * A widget is a rectangle to display on top of the page, e.g. a context
      * menu or a dropdown.
@@ -383,6 +458,19 @@ public:
         int dx, int dy,
         const Rect &scrollRect) {}
 
+    /**
+     * A widget overlay has been painted and Window::setDeferredPaintAck
+     * is on. The default implementation forwards to onWidgetPaint in the
+     * Window::setPaintFormat format.
+     *
+     * \see onPaintFrame
+     * \param win  Window instance that fired this event.
+     * \param wid Widget this event is for
+     * \param frame  Handle to the buffer and rects, see onWidgetPaint.
+     */
+    virtual void onWidgetPaintFrame(Window *win, Widget *wid,
+                                    PaintFrame *frame);
+
     /**
      * Invoked when the Window requests that the mouse cursor be updated.
      * \param win  Window instance that fired this event.
@@ -31,10 +31,53 @@
  */
 
 #include "berkelium/Berkelium.hpp"
+#include "berkelium/Capture.hpp"
+#include "berkelium/Window.hpp"
 #include "Root.hpp"
+#include "PaintDispatcher.hpp"
+#include "FrameBufferBudget.hpp"
+
+#include "base/platform_thread.h"
+#include "base/time.h"
+
+#if defined (OS_WIN)
+#include <windows.h> // for GetTickCount()
+#elif defined (OS_POSIX)
+#include <sys/time.h>
+#endif
 
 namespace Berkelium {
 
+namespace {
+
+// Counts the images of a captureAll before passing them on.
+class CaptureCounter : public CaptureDelegate {
+public:
+    explicit CaptureCounter(CaptureDelegate *target)
+        : mTarget(target), mDone(0), mAllComplete(true) {
+    }
+    virtual void onCapture(Window *win, const FrameBuffer *frame,
+                           const CaptureInfo &info) {
+        ++mDone;
+        if (!info.complete) {
+            mAllComplete = false;
+        }
+        mTarget->onCapture(win, frame, info);
+    }
+    size_t done() const {
+        return mDone;
+    }
+    bool allComplete() const {
+        return mAllComplete;
+    }
+private:
+    CaptureDelegate *mTarget;
+    size_t mDone;
+    bool mAllComplete;
+};
+
+}
+
 // See ForkedProcessHook.cpp for Berkelium::forkedProcessHook
 
 void init (FileString homeDirectory) {
@@ -49,5 +92,53 @@ void update () {
 void setErrorHandler (ErrorDelegate *errorHandler) {
     Root::getSingleton().setErrorHandler(errorHandler);
 }
+bool captureAll (Window *const *windows, size_t numWindows,
+                 CaptureDelegate *callback, int timeoutMs) {
+    CaptureCounter counter(callback);
+    base::TimeTicks deadline = base::TimeTicks::Now() +
+        base::TimeDelta::FromMilliseconds(timeoutMs);
+    for (size_t i = 0; i < numWindows; ++i) {
+        windows[i]->captureFrame(&counter);
+    }
+    while (counter.done() < numWindows) {
+        update();
+        if (counter.done() >= numWindows) {
+            break;
+        }
+        if (timeoutMs > 0 && base::TimeTicks::Now() >= deadline) {
+            for (size_t i = 0; i < numWindows; ++i) {
+                windows[i]->cancelCapture(&counter);
+            }
+            break;
+        }
+        PlatformThread::Sleep(1);
+    }
+    return counter.allComplete();
+}
+void setPaintThreads (int numThreads) {
+    Root::getSingleton().getPaintDispatcher()->setNumThreads(numThreads);
+}
+
+void setFrameMemoryLimit (size_t bytes) {
+    Root::getSingleton().getFrameBufferBudget()->setLimit(bytes);
+}
+
+size_t getFrameMemoryUsage () {
+    return Root::getSingleton().getFrameBufferBudget()->getUsage();
+}
+
+double getInputTime () {
+#ifdef _WIN32
+    return GetTickCount()/1000.0;
+#else
+    timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + ((double)tv.tv_usec)/1000000.0;
+#endif
+}
+
+PaintStats getPaintStats () {
+    return Root::getSingleton().getPaintTotals();
+}
 
 }
@@ -0,0 +1,591 @@
+/*  Berkelium Implementation
+ *  DeltaStream.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/DeltaStream.hpp"
+#include "berkelium/PaintFrame.hpp"
+#include "FrameBufferImpl.hpp"
+#include "base/basictypes.h"
+
+#include <map>
+#include <string.h>
+#include <vector>
+
+namespace Berkelium {
+
+namespace {
+
+// Every command starts with one of these. Numbers are little endian, rects
+// are left, top, width, height as 16 bit values, pixels are BGRA.
+enum Opcode {
+    // u16 width, u16 height. Clears the image.
+    OP_RESIZE = 1,
+    // rect, s16 dx, s16 dy. Same as FrameBufferImpl::scroll.
+    OP_SCROLL,
+    // rect, 4 byte pixel.
+    OP_FILL,
+    // rect, width * height pixels.
+    OP_RAW,
+    // rect, u32 length, runs.
+    OP_RUNS,
+    // As OP_RAW and OP_RUNS, with a u16 cache slot after the rect that the
+    // tile is stored in.
+    OP_CACHE_RAW,
+    OP_CACHE_RUNS,
+    // rect, u16 cache slot to copy from.
+    OP_CACHED,
+    // End of one paint.
+    OP_END_PAINT
+};
+
+const int kBytesPerPixel = 4;
+const size_t kRectBytes = 8;
+const int kMaxCacheTiles = 65535;
+
+inline uint32 loadPixel(const unsigned char *p) {
+    uint32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// FNV-1a; only has to find candidates, matches are compared in full.
+uint32 hashTile(const unsigned char *src, size_t stride, size_t rowBytes,
+                int rows) {
+    uint32 h = 2166136261u;
+    for (int y = 0; y < rows; ++y, src += stride) {
+        for (size_t x = 0; x < rowBytes; ++x) {
+            h = (h ^ src[x]) * 16777619u;
+        }
+    }
+    return h;
+}
+
+class DeltaEncoderImpl : public DeltaEncoder {
+public:
+    DeltaEncoderImpl(DeltaSink *sink, int tileSize, int cacheTiles);
+
+    virtual void encode(const PaintFrame *frame);
+    virtual void reset();
+    virtual DeltaStats getStats() const {
+        return mStats;
+    }
+
+private:
+    struct CachedTile {
+        bool used;
+        uint32 hash;
+        std::vector<unsigned char> pixels;
+    };
+
+    void encodeTile(const unsigned char *src, size_t stride, const Rect &r);
+    bool encodeRuns(const unsigned char *src, size_t stride, const Rect &r,
+                    size_t limit);
+    int findCached(uint32 hash, const unsigned char *src, size_t stride,
+                   size_t rowBytes) const;
+    int storeCached(uint32 hash, const unsigned char *src, size_t stride,
+                    size_t rowBytes);
+
+    void put8(unsigned int v) {
+        mOut.push_back((unsigned char)v);
+    }
+    void put16(unsigned int v) {
+        put8(v);
+        put8(v >> 8);
+    }
+    void put32(uint32 v) {
+        put16(v);
+        put16(v >> 16);
+    }
+    void putRect(const Rect &r) {
+        put16(r.left());
+        put16(r.top());
+        put16(r.width());
+        put16(r.height());
+    }
+    void putRows(const unsigned char *src, size_t stride, size_t rowBytes,
+                 int rows) {
+        for (int y = 0; y < rows; ++y, src += stride) {
+            mOut.insert(mOut.end(), src, src + rowBytes);
+        }
+    }
+
+    DeltaSink *mSink;
+    int mTileSize;
+    int mWidth;
+    int mHeight;
+    std::vector<unsigned char> mOut;
+    std::vector<unsigned char> mRuns;
+
+    std::vector<CachedTile> mCache;
+    std::multimap<uint32, int> mCacheIndex;
+    int mNextSlot;
+
+    DeltaStats mStats;
+};
+
+DeltaEncoderImpl::DeltaEncoderImpl(DeltaSink *sink, int tileSize,
+                                   int cacheTiles)
+    : mSink(sink) {
+    mTileSize = tileSize > 0 ? tileSize : 32;
+    if (cacheTiles < 0) cacheTiles = 0;
+    if (cacheTiles > kMaxCacheTiles) cacheTiles = kMaxCacheTiles;
+    mCache.resize(cacheTiles);
+    memset(&mStats, 0, sizeof(mStats));
+    reset();
+}
+
+void DeltaEncoderImpl::reset() {
+    mWidth = mHeight = -1;
+    for (size_t i = 0; i < mCache.size(); ++i) {
+        mCache[i].used = false;
+    }
+    mCacheIndex.clear();
+    mNextSlot = 0;
+}
+
+void DeltaEncoderImpl::encode(const PaintFrame *frame) {
+    Rect bounds;
+    bounds.mLeft = bounds.mTop = 0;
+    bounds.mWidth = frame->getViewWidth();
+    bounds.mHeight = frame->getViewHeight();
+    if (bounds.width() != mWidth || bounds.height() != mHeight) {
+        mWidth = bounds.width();
+        mHeight = bounds.height();
+        put8(OP_RESIZE);
+        put16(mWidth);
+        put16(mHeight);
+    }
+    if (frame->getDx() || frame->getDy()) {
+        Rect scrolled = frame->getScrollRect().intersect(bounds);
+        if (scrolled.width() > 0 && scrolled.height() > 0) {
+            put8(OP_SCROLL);
+            putRect(scrolled);
+            put16(frame->getDx());
+            put16(frame->getDy());
+            ++mStats.scrolls;
+        }
+    }
+
+    const Rect &bufferRect = frame->getBufferRect();
+    const size_t stride = (size_t)bufferRect.width() * kBytesPerPixel;
+    for (size_t i = 0; i < frame->getNumCopyRects(); ++i) {
+        // The same clipping as FrameBufferImpl::blit.
+        Rect r = frame->getCopyRects()[i].intersect(bufferRect)
+            .intersect(bounds);
+        if (r.width() <= 0 || r.height() <= 0) {
+            continue;
+        }
+        mStats.pixelBytes += (double)r.width() * r.height() * kBytesPerPixel;
+        int firstX = r.left() - r.left() % mTileSize;
+        int firstY = r.top() - r.top() % mTileSize;
+        for (int ty = firstY; ty < r.bottom(); ty += mTileSize) {
+            for (int tx = firstX; tx < r.right(); tx += mTileSize) {
+                Rect tile;
+                tile.mLeft = tx;
+                tile.mTop = ty;
+                tile.mWidth = tile.mHeight = mTileSize;
+                tile = tile.intersect(r);
+                encodeTile(frame->getBuffer()
+                           + (tile.top() - bufferRect.top()) * stride
+                           + (tile.left() - bufferRect.left())
+                               * kBytesPerPixel,
+                           stride, tile);
+            }
+        }
+    }
+
+    put8(OP_END_PAINT);
+    ++mStats.paints;
+    mStats.bytesWritten += mOut.size();
+    mSink->write(&mOut[0], mOut.size());
+    mOut.clear();
+}
+
+void DeltaEncoderImpl::encodeTile(const unsigned char *src, size_t stride,
+                                  const Rect &r) {
+    const size_t rowBytes = (size_t)r.width() * kBytesPerPixel;
+    uint32 first = loadPixel(src);
+    bool solid = true;
+    for (int y = 0; y < r.height() && solid; ++y) {
+        const unsigned char *row = src + y * stride;
+        for (size_t x = 0; x < rowBytes; x += kBytesPerPixel) {
+            if (loadPixel(row + x) != first) {
+                solid = false;
+                break;
+            }
+        }
+    }
+    if (solid) {
+        put8(OP_FILL);
+        putRect(r);
+        mOut.insert(mOut.end(), src, src + kBytesPerPixel);
+        ++mStats.solidTiles;
+        return;
+    }
+
+    // Only whole tiles are worth remembering; the edges of copy rects
+    // rarely line up twice.
+    bool cacheable = !mCache.empty() &&
+        r.width() == mTileSize && r.height() == mTileSize;
+    uint32 hash = 0;
+    int slot = -1;
+    if (cacheable) {
+        hash = hashTile(src, stride, rowBytes, r.height());
+        slot = findCached(hash, src, stride, rowBytes);
+        if (slot >= 0) {
+            put8(OP_CACHED);
+            putRect(r);
+            put16(slot);
+            ++mStats.cachedTiles;
+            return;
+        }
+        slot = storeCached(hash, src, stride, rowBytes);
+    }
+
+    size_t rawBytes = rowBytes * r.height();
+    if (encodeRuns(src, stride, r, rawBytes)) {
+        put8(cacheable ? OP_CACHE_RUNS : OP_RUNS);
+        putRect(r);
+        if (cacheable) {
+            put16(slot);
+        }
+        put32(mRuns.size());
+        mOut.insert(mOut.end(), mRuns.begin(), mRuns.end());
+        ++mStats.runLengthTiles;
+    } else {
+        put8(cacheable ? OP_CACHE_RAW : OP_RAW);
+        putRect(r);
+        if (cacheable) {
+            put16(slot);
+        }
+        putRows(src, stride, rowBytes, r.height());
+        ++mStats.rawTiles;
+    }
+}
+
+// Runs of equal pixels in row order, each a LEB128 length - 1 and the
+// pixel. Gives up once it would take limit bytes.
+bool DeltaEncoderImpl::encodeRuns(const unsigned char *src, size_t stride,
+                                  const Rect &r, size_t limit) {
+    mRuns.clear();
+    const int count = r.width() * r.height();
+    int i = 0;
+    while (i < count) {
+        const unsigned char *pixel = src + (i / r.width()) * stride
+            + (i % r.width()) * kBytesPerPixel;
+        uint32 value = loadPixel(pixel);
+        int run = 1;
+        while (i + run < count) {
+            int j = i + run;
+            if (loadPixel(src + (j / r.width()) * stride
+                          + (j % r.width()) * kBytesPerPixel) != value) {
+                break;
+            }
+            ++run;
+        }
+        unsigned int length = run - 1;
+        while (length >= 0x80) {
+            mRuns.push_back((unsigned char)(length | 0x80));
+            length >>= 7;
+        }
+        mRuns.push_back((unsigned char)length);
+        mRuns.insert(mRuns.end(), pixel, pixel + kBytesPerPixel);
+        if (mRuns.size() >= limit) {
+            return false;
+        }
+        i += run;
+    }
+    return true;
+}
+
+int DeltaEncoderImpl::findCached(uint32 hash, const unsigned char *src,
+                                 size_t stride, size_t rowBytes) const {
+    typedef std::multimap<uint32, int>::const_iterator Iter;
+    std::pair<Iter, Iter> range = mCacheIndex.equal_range(hash);
+    for (Iter it = range.first; it != range.second; ++it) {
+        const unsigned char *cached = &mCache[it->second].pixels[0];
+        bool same = true;
+        for (int y = 0; y < mTileSize && same; ++y) {
+            same = memcmp(cached + y * rowBytes, src + y * stride,
+                          rowBytes) == 0;
+        }
+        if (same) {
+            return it->second;
+        }
+    }
+    return -1;
+}
+
+int DeltaEncoderImpl::storeCached(uint32 hash, const unsigned char *src,
+                                  size_t stride, size_t rowBytes) {
+    int slot = mNextSlot;
+    mNextSlot = (mNextSlot + 1) % mCache.size();
+    CachedTile &tile = mCache[slot];
+    if (tile.used) {
+        typedef std::multimap<uint32, int>::iterator Iter;
+        std::pair<Iter, Iter> range = mCacheIndex.equal_range(tile.hash);
+        for (Iter it = range.first; it != range.second; ++it) {
+            if (it->second == slot) {
+                mCacheIndex.erase(it);
+                break;
+            }
+        }
+    }
+    tile.used = true;
+    tile.hash = hash;
+    tile.pixels.resize(rowBytes * mTileSize);
+    for (int y = 0; y < mTileSize; ++y) {
+        memcpy(&tile.pixels[y * rowBytes], src + y * stride, rowBytes);
+    }
+    mCacheIndex.insert(std::make_pair(hash, slot));
+    return slot;
+}
+
+class DeltaDecoderImpl : public DeltaDecoder {
+public:
+    DeltaDecoderImpl() : mCorrupt(false), mPaints(0) {}
+
+    virtual bool decode(const unsigned char *data, size_t length);
+    virtual const FrameBuffer *getFrame() const {
+        return &mFrame;
+    }
+    virtual unsigned int getPaintsDecoded() const {
+        return mPaints;
+    }
+
+private:
+    struct CachedTile {
+        Rect rect;
+        std::vector<unsigned char> pixels;
+    };
+
+    // Returns the bytes the command at in takes, 0 if it is incomplete,
+    // or -1 if it is corrupt.
+    long apply(const unsigned char *in, size_t available);
+    bool decodeRuns(const unsigned char *in, size_t length, const Rect &r);
+
+    static unsigned int get16(const unsigned char *in) {
+        return in[0] | (in[1] << 8);
+    }
+    static uint32 get32(const unsigned char *in) {
+        return get16(in) | ((uint32)get16(in + 2) << 16);
+    }
+    static Rect getRect(const unsigned char *in) {
+        Rect r;
+        r.mLeft = get16(in);
+        r.mTop = get16(in + 2);
+        r.mWidth = get16(in + 4);
+        r.mHeight = get16(in + 6);
+        return r;
+    }
+
+    FrameBufferImpl mFrame;
+    std::vector<unsigned char> mPending;
+    std::vector<unsigned char> mTile;
+    std::vector<CachedTile> mCache;
+    bool mCorrupt;
+    unsigned int mPaints;
+};
+
+bool DeltaDecoderImpl::decode(const unsigned char *data, size_t length) {
+    if (mCorrupt) {
+        return false;
+    }
+    mPending.insert(mPending.end(), data, data + length);
+    size_t done = 0;
+    while (done < mPending.size()) {
+        long used = apply(&mPending[done], mPending.size() - done);
+        if (used < 0) {
+            mCorrupt = true;
+            mPending.clear();
+            return false;
+        }
+        if (used == 0) {
+            break;
+        }
+        done += used;
+    }
+    mPending.erase(mPending.begin(), mPending.begin() + done);
+    return true;
+}
+
+long DeltaDecoderImpl::apply(const unsigned char *in, size_t available) {
+    const int op = in[0];
+    if (op == OP_END_PAINT) {
+        ++mPaints;
+        return 1;
+    }
+    if (op == OP_RESIZE) {
+        if (available < 5) {
+            return 0;
+        }
+        mFrame.resize(get16(in + 1), get16(in + 3));
+        return 5;
+    }
+    if (op < OP_RESIZE || op > OP_END_PAINT) {
+        return -1;
+    }
+    if (available < 1 + kRectBytes) {
+        return 0;
+    }
+    Rect r = getRect(in + 1);
+    if (r.width() <= 0 || r.height() <= 0 ||
+        r.right() > mFrame.getWidth() || r.bottom() > mFrame.getHeight()) {
+        return -1;
+    }
+    size_t pos = 1 + kRectBytes;
+    const size_t rowBytes = (size_t)r.width() * kBytesPerPixel;
+    const size_t tileBytes = rowBytes * r.height();
+
+    if (op == OP_SCROLL) {
+        if (available < pos + 4) {
+            return 0;
+        }
+        mFrame.scroll(r, (short)get16(in + pos), (short)get16(in + pos + 2));
+        return pos + 4;
+    }
+    if (op == OP_FILL) {
+        if (available < pos + kBytesPerPixel) {
+            return 0;
+        }
+        unsigned char *out = mFrame.getMutableBuffer()
+            + r.top() * mFrame.getStride() + r.left() * kBytesPerPixel;
+        for (int y = 0; y < r.height(); ++y, out += mFrame.getStride()) {
+            for (size_t x = 0; x < rowBytes; x += kBytesPerPixel) {
+                memcpy(out + x, in + pos, kBytesPerPixel);
+            }
+        }
+        return pos + kBytesPerPixel;
+    }
+
+    int slot = -1;
+    if (op == OP_CACHED || op == OP_CACHE_RAW || op == OP_CACHE_RUNS) {
+        if (available < pos + 2) {
+            return 0;
+        }
+        slot = get16(in + pos);
+        pos += 2;
+    }
+    if (op == OP_CACHED) {
+        if (slot >= (int)mCache.size() ||
+            mCache[slot].rect.width() != r.width() ||
+            mCache[slot].rect.height() != r.height()) {
+            return -1;
+        }
+        mFrame.blit(&mCache[slot].pixels[0], r, r);
+        return pos;
+    }
+
+    const unsigned char *pixels;
+    if (op == OP_RAW || op == OP_CACHE_RAW) {
+        if (available < pos + tileBytes) {
+            return 0;
+        }
+        pixels = in + pos;
+        pos += tileBytes;
+    } else {
+        if (available < pos + 4) {
+            return 0;
+        }
+        uint32 length = get32(in + pos);
+        pos += 4;
+        if (length > tileBytes) {
+            return -1;
+        }
+        if (available < pos + length) {
+            return 0;
+        }
+        if (!decodeRuns(in + pos, length, r)) {
+            return -1;
+        }
+        pixels = &mTile[0];
+        pos += length;
+    }
+    mFrame.blit(pixels, r, r);
+    if (slot >= 0) {
+        if (slot >= (int)mCache.size()) {
+            mCache.resize(slot + 1);
+        }
+        mCache[slot].rect = r;
+        mCache[slot].pixels.assign(pixels, pixels + tileBytes);
+    }
+    return pos;
+}
+
+bool DeltaDecoderImpl::decodeRuns(const unsigned char *in, size_t length,
+                                  const Rect &r) {
+    const size_t count = (size_t)r.width() * r.height();
+    mTile.resize(count * kBytesPerPixel);
+    size_t filled = 0;
+    size_t pos = 0;
+    while (pos < length) {
+        size_t run = 0;
+        int shift = 0;
+        for (;;) {
+            if (pos >= length || shift > 28) {
+                return false;
+            }
+            unsigned char b = in[pos++];
+            run |= (size_t)(b & 0x7f) << shift;
+            shift += 7;
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        ++run;
+        if (pos + kBytesPerPixel > length || filled + run > count) {
+            return false;
+        }
+        for (size_t i = 0; i < run; ++i) {
+            memcpy(&mTile[(filled + i) * kBytesPerPixel], in + pos,
+                   kBytesPerPixel);
+        }
+        filled += run;
+        pos += kBytesPerPixel;
+    }
+    return filled == count;
+}
+
+}
+
+DeltaEncoder *DeltaEncoder::create(DeltaSink *sink, int tileSize,
+                                   int cacheTiles) {
+    return new DeltaEncoderImpl(sink, tileSize, cacheTiles);
+}
+
+DeltaDecoder *DeltaDecoder::create() {
+    return new DeltaDecoderImpl;
+}
+
+}
@@ -0,0 +1,104 @@
+/*  Berkelium Implementation
+ *  FrameBufferBudget.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "FrameBufferBudget.hpp"
+#include "WindowImpl.hpp"
+
+#include <vector>
+
+namespace Berkelium {
+
+FrameBufferBudget::FrameBufferBudget()
+    : mUsage(0), mLimit(0) {
+}
+
+FrameBufferBudget::~FrameBufferBudget() {
+}
+
+void FrameBufferBudget::setLimit(size_t bytes) {
+    mLimit = bytes;
+    trim();
+}
+
+void FrameBufferBudget::touch(WindowImpl *win, size_t bytes) {
+    std::map<WindowImpl*, EntryList::iterator>::iterator found =
+        mIndex.find(win);
+    if (found != mIndex.end()) {
+        EntryList::iterator entry = found->second;
+        mUsage -= entry->bytes;
+        entry->bytes = bytes;
+        // Moves the node itself, so the iterator in mIndex stays valid.
+        mEntries.splice(mEntries.begin(), mEntries, entry);
+    } else {
+        Entry entry;
+        entry.window = win;
+        entry.bytes = bytes;
+        mEntries.push_front(entry);
+        mIndex[win] = mEntries.begin();
+    }
+    mUsage += bytes;
+    // The caller is still using its frame buffer.
+    trim(win);
+}
+
+void FrameBufferBudget::remove(WindowImpl *win) {
+    std::map<WindowImpl*, EntryList::iterator>::iterator found =
+        mIndex.find(win);
+    if (found == mIndex.end()) {
+        return;
+    }
+    mUsage -= found->second->bytes;
+    mEntries.erase(found->second);
+    mIndex.erase(found);
+}
+
+void FrameBufferBudget::trim(WindowImpl *keep) {
+    if (!mLimit || mUsage <= mLimit) {
+        return;
+    }
+    // Evicting calls remove(), so don't walk the list while doing it.
+    std::vector<WindowImpl*> oldestFirst;
+    oldestFirst.reserve(mEntries.size());
+    for (EntryList::reverse_iterator it = mEntries.rbegin();
+         it != mEntries.rend(); ++it) {
+        if (it->window != keep) {
+            oldestFirst.push_back(it->window);
+        }
+    }
+    for (size_t i = 0; i < oldestFirst.size() && mUsage > mLimit; ++i) {
+        oldestFirst[i]->evictFrameBuffer();
+    }
+}
+
+}
@@ -0,0 +1,92 @@
+/*  Berkelium Implementation
+ *  FrameBufferBudget.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_FRAMEBUFFERBUDGET_HPP_
+#define _BERKELIUM_FRAMEBUFFERBUDGET_HPP_
+
+#include <stddef.h>
+#include <list>
+#include <map>
+
+namespace Berkelium {
+
+class WindowImpl;
+
+/** Keeps the memory of all Window frame buffers under
+ *  Berkelium::setFrameMemoryLimit. Windows are kept in least recently
+ *  painted order; when over the limit, the oldest hidden ones drop their
+ *  frame buffer and repaint once shown again. Visible windows are never
+ *  evicted, so the limit can be exceeded by what is on screen. Lives in
+ *  Root. UI thread only.
+ */
+class FrameBufferBudget {
+public:
+    FrameBufferBudget();
+    ~FrameBufferBudget();
+
+    /** 0, the default, means no limit. */
+    void setLimit(size_t bytes);
+    size_t getUsage() const {
+        return mUsage;
+    }
+
+    /** Win's frame buffer was painted and now takes bytes. Evicts other
+     *  windows if that goes over the limit.
+     */
+    void touch(WindowImpl *win, size_t bytes);
+
+    /** Win's frame buffer was freed. */
+    void remove(WindowImpl *win);
+
+    /** Evicts until under the limit, or nothing evictable is left.
+     * \param keep  Window to leave alone, if any.
+     */
+    void trim(WindowImpl *keep = NULL);
+
+private:
+    struct Entry {
+        WindowImpl *window;
+        size_t bytes;
+    };
+    typedef std::list<Entry> EntryList;
+
+    // Most recently painted first.
+    EntryList mEntries;
+    std::map<WindowImpl*, EntryList::iterator> mIndex;
+    size_t mUsage;
+    size_t mLimit;
+};
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+/*  Berkelium Implementation
+ *  FrameBufferImpl.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/PaintFrame.hpp"
+#include "FrameBufferImpl.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace Berkelium {
+
+namespace {
+
+const int kBytesPerPixel = 4;
+
+// Rows start on 16 byte boundaries so they can be fed to SSE code.
+size_t alignedStride(int width) {
+    return ((size_t)width * kBytesPerPixel + 15) & ~(size_t)15;
+}
+
+// Copies a block of rows. memcpy/memmove are already vectorized by the C
+// library; the one thing we can add is collapsing contiguous rows into a
+// single call.
+void copyRows(unsigned char *dest, size_t destStride,
+              const unsigned char *src, size_t srcStride,
+              size_t rowBytes, int rows) {
+    if (rowBytes == destStride && rowBytes == srcStride) {
+        memcpy(dest, src, rowBytes * rows);
+        return;
+    }
+    for (int y = 0; y < rows; ++y) {
+        memcpy(dest, src, rowBytes);
+        dest += destStride;
+        src += srcStride;
+    }
+}
+
+}
+
+FrameBufferImpl::FrameBufferImpl() {
+    mCapacity = 0;
+}
+
+FrameBufferImpl::~FrameBufferImpl() {
+    free(mBuffer);
+}
+
+bool FrameBufferImpl::resize(int width, int height) {
+    if (width < 0) width = 0;
+    if (height < 0) height = 0;
+    if (width == mWidth && height == mHeight) {
+        return false;
+    }
+    size_t stride = alignedStride(width);
+    size_t bytes = stride * height;
+    if (bytes > mCapacity) {
+        free(mBuffer);
+        mBuffer = static_cast<unsigned char*>(malloc(bytes));
+        if (!mBuffer) {
+            mCapacity = 0;
+            mWidth = mHeight = 0;
+            mStride = 0;
+            return true;
+        }
+        mCapacity = bytes;
+    }
+    mWidth = width;
+    mHeight = height;
+    mStride = stride;
+    if (bytes) {
+        memset(mBuffer, 0, bytes);
+    }
+    return true;
+}
+
+void FrameBufferImpl::scroll(const Rect &scrollRect, int dx, int dy) {
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+    Rect clip = scrollRect.intersect(getBounds());
+    // Where the moved pixels come from, and where they go.
+    Rect src = clip.intersect(clip.translate(-dx, -dy));
+    if (src.width() <= 0 || src.height() <= 0) {
+        return;
+    }
+    Rect dest = src.translate(dx, dy);
+
+    const size_t rowBytes = (size_t)src.width() * kBytesPerPixel;
+    const unsigned char *in = mBuffer + src.top() * mStride
+        + src.left() * kBytesPerPixel;
+    unsigned char *out = mBuffer + dest.top() * mStride
+        + dest.left() * kBytesPerPixel;
+    if (dy > 0) {
+        // Moving down: walk bottom-up so we don't overwrite unread rows.
+        for (int y = src.height() - 1; y >= 0; --y) {
+            memcpy(out + y * mStride, in + y * mStride, rowBytes);
+        }
+    } else if (dy < 0) {
+        for (int y = 0; y < src.height(); ++y) {
+            memcpy(out + y * mStride, in + y * mStride, rowBytes);
+        }
+    } else {
+        // Horizontal only: source and destination overlap within a row.
+        for (int y = 0; y < src.height(); ++y) {
+            memmove(out + y * mStride, in + y * mStride, rowBytes);
+        }
+    }
+}
+
+void FrameBufferImpl::blit(const unsigned char *src, const Rect &srcRect,
+                           const Rect &destRect) {
+    Rect r = destRect.intersect(srcRect).intersect(getBounds());
+    if (r.width() <= 0 || r.height() <= 0) {
+        return;
+    }
+    const size_t srcStride = (size_t)srcRect.width() * kBytesPerPixel;
+    copyRows(mBuffer + r.top() * mStride + r.left() * kBytesPerPixel,
+             mStride,
+             src + (r.top() - srcRect.top()) * srcStride
+                 + (r.left() - srcRect.left()) * kBytesPerPixel,
+             srcStride,
+             (size_t)r.width() * kBytesPerPixel,
+             r.height());
+}
+
+void FrameBufferImpl::copyFrom(const FrameBuffer &src, const Rect &rect) {
+    Rect srcBounds;
+    srcBounds.mLeft = srcBounds.mTop = 0;
+    srcBounds.mWidth = src.getWidth();
+    srcBounds.mHeight = src.getHeight();
+    Rect r = rect.intersect(srcBounds).intersect(getBounds());
+    if (r.width() <= 0 || r.height() <= 0) {
+        return;
+    }
+    copyRows(mBuffer + r.top() * mStride + r.left() * kBytesPerPixel,
+             mStride,
+             src.getBuffer() + r.top() * src.getStride()
+                 + r.left() * kBytesPerPixel,
+             src.getStride(),
+             (size_t)r.width() * kBytesPerPixel,
+             r.height());
+}
+
+void FrameBufferImpl::applyPaint(const PaintFrame *frame,
+                                 std::vector<Rect> *dirty) {
+    if (resize(frame->getViewWidth(), frame->getViewHeight())) {
+        dirty->push_back(getBounds());
+    }
+    if (frame->getDx() || frame->getDy()) {
+        scroll(frame->getScrollRect(), frame->getDx(), frame->getDy());
+        Rect scrolled = frame->getScrollRect().intersect(getBounds());
+        if (scrolled.width() > 0 && scrolled.height() > 0) {
+            dirty->push_back(scrolled);
+        }
+    }
+    const Rect *copyRects = frame->getCopyRects();
+    for (size_t i = 0; i < frame->getNumCopyRects(); ++i) {
+        blit(frame->getBuffer(), frame->getBufferRect(), copyRects[i]);
+        Rect r = copyRects[i].intersect(getBounds());
+        if (r.width() > 0 && r.height() > 0) {
+            dirty->push_back(r);
+        }
+    }
+}
+
+}
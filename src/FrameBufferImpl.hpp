@@ -0,0 +1,103 @@
+/*  Berkelium Implementation
+ *  FrameBufferImpl.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_FRAMEBUFFERIMPL_HPP_
+#define _BERKELIUM_FRAMEBUFFERIMPL_HPP_
+
+#include "berkelium/FrameBuffer.hpp"
+#include "berkelium/Rect.hpp"
+
+#include <vector>
+
+namespace Berkelium {
+
+class PaintFrame;
+
+class FrameBufferImpl : public FrameBuffer {
+public:
+    FrameBufferImpl();
+    ~FrameBufferImpl();
+
+    inline unsigned char *getMutableBuffer() {
+        return mBuffer;
+    }
+    inline Rect getBounds() const {
+        Rect ret;
+        ret.mLeft = ret.mTop = 0;
+        ret.mWidth = mWidth;
+        ret.mHeight = mHeight;
+        return ret;
+    }
+
+    /** Bytes allocated for the image. */
+    inline size_t getMemorySize() const {
+        return mCapacity;
+    }
+
+    /** Changes the image size. The contents are cleared if it changed.
+     *  \returns true if the size changed
+     */
+    bool resize(int width, int height);
+
+    /** Moves the contents of scrollRect by (dx, dy), clipped to scrollRect.
+     *  The part that gets exposed keeps its old contents.
+     */
+    void scroll(const Rect &scrollRect, int dx, int dy);
+
+    /** Copies destRect out of a tightly packed BGRA image covering srcRect.
+     *  Both rects are in frame coordinates; destRect is clipped to the
+     *  frame and srcRect.
+     */
+    void blit(const unsigned char *src, const Rect &srcRect,
+              const Rect &destRect);
+
+    /** Copies rect from another frame at the same position, clipped to
+     *  both.
+     */
+    void copyFrom(const FrameBuffer &src, const Rect &rect);
+
+    /** Applies a whole paint: resizes to the view, scrolls, then copies the
+     *  copy rects. Every changed area is appended to dirty.
+     */
+    void applyPaint(const PaintFrame *frame, std::vector<Rect> *dirty);
+
+private:
+    FrameBufferImpl(const FrameBufferImpl&);
+    FrameBufferImpl& operator=(const FrameBufferImpl&);
+
+    size_t mCapacity;
+};
+
+}
+
+#endif
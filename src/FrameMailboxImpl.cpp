@@ -0,0 +1,134 @@
+/*  Berkelium Implementation
+ *  FrameMailboxImpl.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "FrameMailboxImpl.hpp"
+#include "RectUtil.hpp"
+
+namespace Berkelium {
+
+namespace {
+// Beyond this, dirty lists are merged down; a consumer that falls far
+// behind gets a few large rects instead of an ever growing list.
+const size_t kMaxDirtyRects = 32;
+}
+
+FrameMailboxImpl::FrameMailboxImpl() {
+    mFront = 0;
+    mReady = 1;
+    mBack = 2;
+    mHasFront = false;
+    mPublishedWidth = mPublishedHeight = 0;
+}
+
+FrameMailboxImpl::~FrameMailboxImpl() {
+}
+
+void FrameMailboxImpl::addRects(std::vector<Rect> *to,
+                                size_t numRects, const Rect *rects) {
+    to->insert(to->end(), rects, rects + numRects);
+    if (to->size() > kMaxDirtyRects) {
+        to->resize(coalesceRects(&(*to)[0], to->size(), 0, kMaxDirtyRects));
+    }
+}
+
+base::subtle::Atomic32 FrameMailboxImpl::exchange(
+    volatile base::subtle::Atomic32 *state, base::subtle::Atomic32 value)
+{
+    // Both sides hand over a slot they wrote or read, and take one the
+    // other side wrote or read: that needs a full barrier either way.
+    base::subtle::MemoryBarrier();
+    base::subtle::Atomic32 old =
+        base::subtle::NoBarrier_AtomicExchange(state, value);
+    base::subtle::MemoryBarrier();
+    return old;
+}
+
+void FrameMailboxImpl::invalidate(size_t numRects, const Rect *rects) {
+    for (int i = 0; i < NUM_SLOTS; ++i) {
+        addRects(&mMissing[i], numRects, rects);
+    }
+    addRects(&mUnpublished, numRects, rects);
+}
+
+void FrameMailboxImpl::publish(const FrameBuffer &frame) {
+    Slot &back = mSlots[mBack];
+    if (back.image.resize(frame.getWidth(), frame.getHeight())) {
+        back.image.copyFrom(frame, back.image.getBounds());
+    } else {
+        for (size_t i = 0; i < mMissing[mBack].size(); ++i) {
+            back.image.copyFrom(frame, mMissing[mBack][i]);
+        }
+    }
+    mMissing[mBack].clear();
+
+    back.dirty.clear();
+    if (frame.getWidth() != mPublishedWidth ||
+        frame.getHeight() != mPublishedHeight) {
+        // The consumer has nothing of this size to update.
+        back.dirty.push_back(back.image.getBounds());
+        mPublishedWidth = frame.getWidth();
+        mPublishedHeight = frame.getHeight();
+    } else {
+        if (base::subtle::NoBarrier_Load(&mReady) & FRESH) {
+            // The last frame is about to be replaced unseen, so its
+            // changes carry over. If the consumer takes it after all, it
+            // only gets told about a few rects twice.
+            back.dirty = mLastPublished;
+        }
+        if (!mUnpublished.empty()) {
+            addRects(&back.dirty, mUnpublished.size(), &mUnpublished[0]);
+        }
+    }
+    mUnpublished.clear();
+    mLastPublished = back.dirty;
+
+    mBack = exchange(&mReady, mBack | FRESH) & INDEX_MASK;
+}
+
+const FrameBuffer *FrameMailboxImpl::acquire(size_t *numDirty,
+                                             const Rect **dirty) {
+    *numDirty = 0;
+    *dirty = NULL;
+    if (base::subtle::Acquire_Load(&mReady) & FRESH) {
+        // Only the producer sets FRESH, so it is still set below.
+        mFront = exchange(&mReady, mFront) & INDEX_MASK;
+        mHasFront = true;
+        const std::vector<Rect> &rects = mSlots[mFront].dirty;
+        *numDirty = rects.size();
+        *dirty = rects.empty() ? NULL : &rects[0];
+    }
+    return mHasFront ? &mSlots[mFront].image : NULL;
+}
+
+}
@@ -0,0 +1,106 @@
+/*  Berkelium Implementation
+ *  FrameMailboxImpl.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_FRAMEMAILBOXIMPL_HPP_
+#define _BERKELIUM_FRAMEMAILBOXIMPL_HPP_
+
+#include "berkelium/FrameMailbox.hpp"
+#include "FrameBufferImpl.hpp"
+#include "base/atomicops.h"
+
+#include <vector>
+
+namespace Berkelium {
+
+/** Triple buffer behind Window::getFrameMailbox. The UI thread owns one
+ *  slot, the consumer another, and the third is exchanged through
+ *  mReady. Each slot is only brought up to date with the areas it missed
+ *  since it was last published, so a steady page costs nothing but the
+ *  swaps.
+ */
+class FrameMailboxImpl : public FrameMailbox {
+public:
+    FrameMailboxImpl();
+    ~FrameMailboxImpl();
+
+    /** Marks areas of the frame as changed. UI thread. */
+    void invalidate(size_t numRects, const Rect *rects);
+
+    /** Copies what changed into the UI thread's slot and makes it the
+     *  latest frame. UI thread.
+     */
+    void publish(const FrameBuffer &frame);
+
+    virtual const FrameBuffer *acquire(size_t *numDirty, const Rect **dirty);
+
+private:
+    enum {
+        NUM_SLOTS = 3,
+        INDEX_MASK = 3,
+        // Set in mReady until the consumer picks the slot up.
+        FRESH = 4
+    };
+
+    struct Slot {
+        FrameBufferImpl image;
+        // What changed since the frame published before this one.
+        std::vector<Rect> dirty;
+    };
+
+    static void addRects(std::vector<Rect> *to,
+                         size_t numRects, const Rect *rects);
+    static base::subtle::Atomic32 exchange(
+        volatile base::subtle::Atomic32 *state, base::subtle::Atomic32 value);
+
+    Slot mSlots[NUM_SLOTS];
+    // Index of the published slot, plus FRESH.
+    volatile base::subtle::Atomic32 mReady;
+
+    // UI thread.
+    int mBack;
+    // Areas each slot is missing.
+    std::vector<Rect> mMissing[NUM_SLOTS];
+    // Changes not yet in any published dirty list.
+    std::vector<Rect> mUnpublished;
+    std::vector<Rect> mLastPublished;
+    int mPublishedWidth;
+    int mPublishedHeight;
+
+    // Consumer thread.
+    int mFront;
+    bool mHasFront;
+};
+
+}
+
+#endif
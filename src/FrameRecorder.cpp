@@ -0,0 +1,209 @@
+/*  Berkelium Implementation
+ *  FrameRecorder.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/FrameBuffer.hpp"
+#include "berkelium/PixelConvert.hpp"
+#include "FrameRecorder.hpp"
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/message_loop.h"
+#include "base/task.h"
+#include "base/thread.h"
+
+#include <string.h>
+
+namespace Berkelium {
+
+namespace {
+const int kBytesPerPixel = 4;
+}
+
+FrameRecorder::FrameRecorder(RecordFormat format, int fps, int numBuffers)
+    : mFormat(format), mFps(fps), mNumBuffers(numBuffers),
+      mWidth(0), mHeight(0), mLastIndex(-1), mNextBuffer(0),
+      mFile(NULL), mTimestamps(NULL), mHeaderWritten(false) {
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+FrameRecorder::~FrameRecorder() {
+    DCHECK(!mThread.get());
+}
+
+bool FrameRecorder::start(const FilePath &path) {
+    mFile = file_util::OpenFile(path, "wb");
+    if (!mFile) {
+        return false;
+    }
+    if (mFormat == RECORD_RAW_BGRA) {
+        mTimestamps = file_util::OpenFile(
+            FilePath(path.value() + FILE_PATH_LITERAL(".timestamps")), "w");
+        if (!mTimestamps) {
+            file_util::CloseFile(mFile);
+            mFile = NULL;
+            return false;
+        }
+    }
+    mThread.reset(new base::Thread("BerkeliumRecorder"));
+    if (!mThread->Start()) {
+        mThread.reset();
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void FrameRecorder::sample(const FrameBuffer &frame, base::TimeTicks now) {
+    if (mBuffers.empty()) {
+        if (frame.getWidth() <= 0 || frame.getHeight() <= 0) {
+            return;
+        }
+        // Allocated once; nothing is allocated per frame from here on.
+        mWidth = frame.getWidth();
+        mHeight = frame.getHeight();
+        mBuffers.resize(mNumBuffers);
+        for (size_t i = 0; i < mBuffers.size(); ++i) {
+            mBuffers[i].pixels.resize(
+                (size_t)mWidth * mHeight * kBytesPerPixel);
+            mBuffers[i].busy = false;
+        }
+        mStart = now;
+    }
+    int64 elapsed = (now - mStart).InMicroseconds();
+    int64 index = elapsed * mFps / base::Time::kMicrosecondsPerSecond;
+    if (index <= mLastIndex) {
+        // The timer fired early; this interval already has its frame.
+        return;
+    }
+    int64 missed = mLastIndex < 0 ? 0 : index - mLastIndex - 1;
+    mLastIndex = index;
+
+    Buffer &buffer = mBuffers[mNextBuffer];
+    {
+        AutoLock lock(mLock);
+        mStats.dropped += (unsigned int)missed;
+        if (buffer.busy) {
+            // The writer is behind by a whole ring.
+            ++mStats.dropped;
+            return;
+        }
+        buffer.busy = true;
+        ++mStats.queued;
+    }
+    copyFrame(frame, &buffer);
+    buffer.timestamp = elapsed;
+    mThread->message_loop()->PostTask(
+        FROM_HERE, NewRunnableMethod(this, &FrameRecorder::write, mNextBuffer));
+    mNextBuffer = (mNextBuffer + 1) % mBuffers.size();
+}
+
+void FrameRecorder::copyFrame(const FrameBuffer &frame, Buffer *buffer) {
+    const size_t stride = (size_t)mWidth * kBytesPerPixel;
+    int width = frame.getWidth() < mWidth ? frame.getWidth() : mWidth;
+    int height = frame.getHeight() < mHeight ? frame.getHeight() : mHeight;
+    if (width != mWidth || height != mHeight) {
+        memset(&buffer->pixels[0], 0, buffer->pixels.size());
+    }
+    for (int y = 0; y < height; ++y) {
+        memcpy(&buffer->pixels[y * stride],
+               frame.getBuffer() + y * frame.getStride(),
+               (size_t)width * kBytesPerPixel);
+    }
+}
+
+bool FrameRecorder::writeHeader() {
+    mHeaderWritten = true;
+    if (mFormat == RECORD_Y4M) {
+        mConverted.resize(PixelConvert::getImageSize(
+            PIXEL_FORMAT_I420, mWidth, mHeight));
+        return fprintf(mFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                       mWidth, mHeight, mFps) > 0;
+    }
+    return fprintf(mTimestamps, "# %dx%d BGRA, %d fps, microseconds\n",
+                   mWidth, mHeight, mFps) > 0;
+}
+
+void FrameRecorder::write(size_t index) {
+    Buffer &buffer = mBuffers[index];
+    bool ok = mHeaderWritten || writeHeader();
+    if (ok && mFormat == RECORD_Y4M) {
+        Rect all;
+        all.mLeft = all.mTop = 0;
+        all.mWidth = mWidth;
+        all.mHeight = mHeight;
+        PixelConvert::convert(PIXEL_FORMAT_I420, &buffer.pixels[0],
+                              (size_t)mWidth * kBytesPerPixel,
+                              &mConverted[0], mWidth, mHeight, all);
+        ok = fprintf(mFile, "FRAME Xts=%" PRId64 "\n", buffer.timestamp) > 0 &&
+            fwrite(&mConverted[0], 1, mConverted.size(), mFile) ==
+                mConverted.size();
+    } else if (ok) {
+        ok = fwrite(&buffer.pixels[0], 1, buffer.pixels.size(), mFile) ==
+                buffer.pixels.size() &&
+            fprintf(mTimestamps, "%" PRId64 "\n", buffer.timestamp) > 0;
+    }
+
+    AutoLock lock(mLock);
+    buffer.busy = false;
+    if (ok) {
+        ++mStats.written;
+    } else {
+        ++mStats.dropped;
+    }
+}
+
+void FrameRecorder::stop() {
+    if (mThread.get()) {
+        // Runs everything already posted before returning.
+        mThread->Stop();
+        mThread.reset();
+    }
+    if (mFile) {
+        file_util::CloseFile(mFile);
+        mFile = NULL;
+    }
+    if (mTimestamps) {
+        file_util::CloseFile(mTimestamps);
+        mTimestamps = NULL;
+    }
+}
+
+RecordStats FrameRecorder::getStats() const {
+    AutoLock lock(mLock);
+    return mStats;
+}
+
+}
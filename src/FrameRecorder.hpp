@@ -0,0 +1,120 @@
+/*  Berkelium Implementation
+ *  FrameRecorder.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_FRAMERECORDER_HPP_
+#define _BERKELIUM_FRAMERECORDER_HPP_
+
+#include "berkelium/Window.hpp"
+#include "berkelium/Stats.hpp"
+#include "base/basictypes.h"
+#include "base/lock.h"
+#include "base/ref_counted.h"
+#include "base/scoped_ptr.h"
+#include "base/time.h"
+
+#include <stdio.h>
+#include <vector>
+
+class FilePath;
+namespace base {
+class Thread;
+}
+
+namespace Berkelium {
+
+class FrameBuffer;
+
+/** Writes samples of a frame buffer to a file, see Window::startRecording.
+ *  The UI thread copies each sample into a free buffer of a fixed ring and
+ *  hands it to a writer thread, so a slow disk only ever costs dropped
+ *  frames.
+ */
+class FrameRecorder : public base::RefCountedThreadSafe<FrameRecorder> {
+public:
+    FrameRecorder(RecordFormat format, int fps, int numBuffers);
+
+    /** Creates the file(s) and starts the writer thread. UI thread. */
+    bool start(const FilePath &path);
+
+    /** Takes a sample if one is due at now. UI thread. */
+    void sample(const FrameBuffer &frame, base::TimeTicks now);
+
+    /** Writes whatever is queued and closes the file. UI thread. */
+    void stop();
+
+    RecordStats getStats() const;
+
+private:
+    friend class base::RefCountedThreadSafe<FrameRecorder>;
+    ~FrameRecorder();
+
+    struct Buffer {
+        std::vector<unsigned char> pixels;
+        // Microseconds since the first sample.
+        int64 timestamp;
+        // Owned by the writer thread while set.
+        bool busy;
+    };
+
+    void copyFrame(const FrameBuffer &frame, Buffer *buffer);
+    // Writer thread.
+    void write(size_t index);
+    bool writeHeader();
+
+    RecordFormat mFormat;
+    int mFps;
+    int mNumBuffers;
+    // Fixed by the first sample.
+    int mWidth;
+    int mHeight;
+    base::TimeTicks mStart;
+    // Sampling interval of the last sample, or -1.
+    int64 mLastIndex;
+    std::vector<Buffer> mBuffers;
+    size_t mNextBuffer;
+
+    FILE *mFile;
+    // RECORD_RAW_BGRA only.
+    FILE *mTimestamps;
+    bool mHeaderWritten;
+    std::vector<unsigned char> mConverted;
+    scoped_ptr<base::Thread> mThread;
+
+    // Guards the busy flags and mStats.
+    mutable Lock mLock;
+    RecordStats mStats;
+};
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*  Berkelium Implementation
+ *  InputLatencyTracker
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "InputLatencyTracker.hpp"
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+#include "third_party/WebKit/WebKit/chromium/public/WebInputEvent.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace Berkelium {
+
+namespace {
+
+const char *typeName(int type) {
+    switch (type) {
+      case WebKit::WebInputEvent::MouseDown:
+        return "MouseDown";
+      case WebKit::WebInputEvent::MouseUp:
+        return "MouseUp";
+      case WebKit::WebInputEvent::MouseMove:
+        return "MouseMove";
+      case WebKit::WebInputEvent::MouseWheel:
+        return "MouseWheel";
+      case WebKit::WebInputEvent::RawKeyDown:
+        return "RawKeyDown";
+      case WebKit::WebInputEvent::KeyDown:
+        return "KeyDown";
+      case WebKit::WebInputEvent::KeyUp:
+        return "KeyUp";
+      case WebKit::WebInputEvent::Char:
+        return "Char";
+      case WebKit::WebInputEvent::Undefined:
+        return "Text";
+      default:
+        return "Other";
+    }
+}
+
+// Value below which a fraction q of the sorted samples fall.
+double percentile(std::vector<double> &samples, double q) {
+    size_t n = (size_t)(q * (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+    return samples[n];
+}
+
+}
+
+InputLatencyTracker::InputLatencyTracker()
+    : mLastId(0), mNextSample(0), mTrace(NULL) {
+    memset(&mCounts, 0, sizeof(mCounts));
+}
+
+InputLatencyTracker::~InputLatencyTracker() {
+    stopTrace();
+}
+
+void InputLatencyTracker::painted(const TracedInput &input,
+                                  base::TimeTicks now) {
+    double latency = (now - input.queued).InSecondsF();
+    ++mCounts.events;
+    ++mCounts.painted;
+    if (latency > mCounts.maxLatency) {
+        mCounts.maxLatency = latency;
+    }
+    if (mSamples.size() < SAMPLES) {
+        mSamples.push_back(latency);
+    } else {
+        mSamples[mNextSample] = latency;
+        mNextSample = (mNextSample + 1) % SAMPLES;
+    }
+    trace(input, &now);
+}
+
+void InputLatencyTracker::unpainted(const TracedInput &input) {
+    ++mCounts.events;
+    ++mCounts.unpainted;
+    trace(input, NULL);
+}
+
+InputLatencyStats InputLatencyTracker::getStats() const {
+    InputLatencyStats stats = mCounts;
+    if (!mSamples.empty()) {
+        std::vector<double> sorted(mSamples);
+        stats.p50 = percentile(sorted, 0.5);
+        stats.p90 = percentile(sorted, 0.9);
+        stats.p99 = percentile(sorted, 0.99);
+    }
+    return stats;
+}
+
+bool InputLatencyTracker::startTrace(const FilePath &path) {
+    stopTrace();
+    mTrace = file_util::OpenFile(path, "w");
+    if (!mTrace) {
+        return false;
+    }
+    mTraceStart = base::TimeTicks::Now();
+    fprintf(mTrace, "# id type queued acked painted latency, in "
+            "microseconds since the trace started\n");
+    return true;
+}
+
+void InputLatencyTracker::stopTrace() {
+    if (mTrace) {
+        file_util::CloseFile(mTrace);
+        mTrace = NULL;
+    }
+}
+
+void InputLatencyTracker::trace(const TracedInput &input,
+                                const base::TimeTicks *painted) {
+    if (!mTrace) {
+        return;
+    }
+    fprintf(mTrace, "%u %s %lld ", input.id, typeName(input.type),
+            (long long)(input.queued - mTraceStart).InMicroseconds());
+    if (input.acked.is_null()) {
+        fprintf(mTrace, "- ");
+    } else {
+        fprintf(mTrace, "%lld ",
+                (long long)(input.acked - mTraceStart).InMicroseconds());
+    }
+    if (painted) {
+        fprintf(mTrace, "%lld %lld\n",
+                (long long)(*painted - mTraceStart).InMicroseconds(),
+                (long long)(*painted - input.queued).InMicroseconds());
+    } else {
+        fprintf(mTrace, "- -\n");
+    }
+}
+
+}
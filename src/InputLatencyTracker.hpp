@@ -0,0 +1,108 @@
+/*  Berkelium Implementation
+ *  InputLatencyTracker
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_INPUTLATENCYTRACKER_HPP_
+#define _BERKELIUM_INPUTLATENCYTRACKER_HPP_
+
+#include "berkelium/Stats.hpp"
+#include "base/time.h"
+
+#include <stdio.h>
+#include <vector>
+
+class FilePath;
+
+namespace Berkelium {
+
+/** An input event sent to a renderer, on its way to the screen. */
+struct TracedInput {
+    unsigned int id;
+    /** WebKit::WebInputEvent::Type, or Undefined for a text commit. */
+    int type;
+    /** When the Window got it, before any holding back. */
+    base::TimeTicks queued;
+    base::TimeTicks acked;
+    /** The replay log events merged into this one, or -1 for input that
+     *  didn't come from Window::startInputReplay.
+     */
+    int replayFirst;
+    int replayLast;
+};
+
+/** Collects the input-to-paint latencies of one Window, see
+ *  Window::getInputLatencyStats. The RenderWidgets follow each event
+ *  to its ACK and to the paint after it, and report here.
+ */
+class InputLatencyTracker {
+public:
+    enum {
+        // Painted events the percentiles are taken over.
+        SAMPLES = 1024,
+        // Acknowledged events a RenderWidget keeps waiting for a paint;
+        // the oldest beyond that are given up on.
+        MAX_WAITING = 256
+    };
+    // Longest wait for a paint after the ACK, so that events that change
+    // nothing don't get charged for the next unrelated paint.
+    static const int kMaxPaintWaitMs = 1000;
+
+    InputLatencyTracker();
+    ~InputLatencyTracker();
+
+    unsigned int nextId() {
+        return ++mLastId;
+    }
+
+    void painted(const TracedInput &input, base::TimeTicks now);
+    void unpainted(const TracedInput &input);
+
+    InputLatencyStats getStats() const;
+
+    bool startTrace(const FilePath &path);
+    void stopTrace();
+
+private:
+    void trace(const TracedInput &input, const base::TimeTicks *painted);
+
+    unsigned int mLastId;
+    InputLatencyStats mCounts;
+    // Ring of the last SAMPLES latencies, in seconds.
+    std::vector<double> mSamples;
+    size_t mNextSample;
+    FILE *mTrace;
+    base::TimeTicks mTraceStart;
+};
+
+}
+
+#endif
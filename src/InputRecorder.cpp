@@ -0,0 +1,118 @@
+/*  Berkelium Implementation
+ *  InputRecorder.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "berkelium/Platform.hpp"
+#include "InputRecorder.hpp"
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+
+namespace Berkelium {
+
+const char InputRecorder::kMagic[4] = {'B', 'K', 'I', 'N'};
+
+InputRecorder::InputRecorder() : mFile(NULL), mFirst(true) {
+}
+
+InputRecorder::~InputRecorder() {
+    stop();
+}
+
+bool InputRecorder::start(const FilePath &path) {
+    stop();
+    mFile = file_util::OpenFile(path, "wb");
+    if (!mFile) {
+        return false;
+    }
+    fwrite(kMagic, 1, sizeof(kMagic), mFile);
+    putVarint(VERSION);
+    mFirst = true;
+    return true;
+}
+
+void InputRecorder::stop() {
+    if (mFile) {
+        file_util::CloseFile(mFile);
+        mFile = NULL;
+    }
+}
+
+void InputRecorder::putVarint(unsigned long long value) {
+    while (value >= 0x80) {
+        putc((int)(value & 0x7f) | 0x80, mFile);
+        value >>= 7;
+    }
+    putc((int)value, mFile);
+}
+
+void InputRecorder::record(const InputEvent &event, base::TimeTicks now) {
+    if (!mFile) {
+        return;
+    }
+    // The first event starts the clock.
+    long long delay = mFirst ? 0 : (now - mLastEvent).InMicroseconds();
+    mFirst = false;
+    mLastEvent = now;
+
+    putVarint(event.type);
+    putVarint(delay > 0 ? delay : 0);
+    switch (event.type) {
+      case InputEvent::MOUSE_MOVED:
+        putSigned(event.mouseMoved.x);
+        putSigned(event.mouseMoved.y);
+        break;
+      case InputEvent::MOUSE_BUTTON:
+        putVarint(event.mouseButton.buttonID);
+        putVarint(event.mouseButton.down);
+        break;
+      case InputEvent::MOUSE_WHEEL:
+        putSigned(event.mouseWheel.xScroll);
+        putSigned(event.mouseWheel.yScroll);
+        break;
+      case InputEvent::KEY_EVENT:
+        putVarint(event.keyEvent.pressed);
+        putSigned(event.keyEvent.mods);
+        putSigned(event.keyEvent.vk_code);
+        putSigned(event.keyEvent.scancode);
+        break;
+      case InputEvent::TEXT_EVENT:
+        putVarint(event.textEvent.length);
+        for (size_t i = 0; i < event.textEvent.length; ++i) {
+            putVarint((unsigned long)event.textEvent.text[i]);
+        }
+        break;
+    }
+}
+
+}
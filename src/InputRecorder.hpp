@@ -0,0 +1,87 @@
+/*  Berkelium Implementation
+ *  InputRecorder.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _BERKELIUM_INPUTRECORDER_HPP_
+#define _BERKELIUM_INPUTRECORDER_HPP_
+
+#include "berkelium/InputEvent.hpp"
+#include "base/time.h"
+
+#include <stdio.h>
+
+class FilePath;
+
+namespace Berkelium {
+
+/** Writes the input given to a Window to a log, see
+ *  Window::startInputRecording. The format, all numbers LEB128 varints
+ *  with signed ones zigzag coded:
+ *
+ *    "BKIN" version
+ *    per event: type, microseconds since the previous event, then
+ *      MOUSE_MOVED  x y
+ *      MOUSE_BUTTON buttonID down
+ *      MOUSE_WHEEL  xScroll yScroll
+ *      KEY_EVENT    pressed mods vk_code scancode
+ *      TEXT_EVENT   length, then each wchar_t
+ */
+class InputRecorder {
+public:
+    enum {
+        VERSION = 1
+    };
+    static const char kMagic[4];
+
+    InputRecorder();
+    ~InputRecorder();
+
+    bool start(const FilePath &path);
+    void record(const InputEvent &event, base::TimeTicks now);
+    void stop();
+
+private:
+    void putVarint(unsigned long long value);
+    void putSigned(long long value) {
+        putVarint(value < 0 ? ((unsigned long long)~value << 1) | 1
+                            : (unsigned long long)value << 1);
+    }
+
+    FILE *mFile;
+    base::TimeTicks mLastEvent;
+    bool mFirst;
+};
+
+}
+
+#endif
@@ -0,0 +1,243 @@
+/*  Berkelium Implementation
+ *  InputReplayer.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "berkelium/Platform.hpp"
+#include "InputReplayer.hpp"
+#include "WindowImpl.hpp"
+#include "InputRecorder.hpp"
+
+#include "base/file_path.h"
+#include "base/file_util.h"
+
+#include <string.h>
+
+namespace Berkelium {
+
+namespace {
+
+class LogReader {
+public:
+    LogReader(const std::string &data) : mData(data), mPos(0), mOk(true) {}
+
+    bool ok() const {
+        return mOk;
+    }
+    bool atEnd() const {
+        return mPos >= mData.size();
+    }
+    unsigned long long varint() {
+        unsigned long long value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (atEnd()) {
+                break;
+            }
+            unsigned char b = mData[mPos++];
+            value |= (unsigned long long)(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        mOk = false;
+        return 0;
+    }
+    long long signedVarint() {
+        unsigned long long n = varint();
+        return (n & 1) ? ~(long long)(n >> 1) : (long long)(n >> 1);
+    }
+
+private:
+    const std::string &mData;
+    size_t mPos;
+    bool mOk;
+};
+
+}
+
+InputReplayer::InputReplayer()
+    : mSpeed(1), mNext(0), mNumWaiting(0) {
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+bool InputReplayer::load(const FilePath &path) {
+    std::string data;
+    if (!file_util::ReadFileToString(path, &data) ||
+        data.size() < sizeof(InputRecorder::kMagic) ||
+        memcmp(data.data(), InputRecorder::kMagic,
+               sizeof(InputRecorder::kMagic))) {
+        return false;
+    }
+    data.erase(0, sizeof(InputRecorder::kMagic));
+    LogReader in(data);
+    if (in.varint() != InputRecorder::VERSION) {
+        return false;
+    }
+
+    mEvents.clear();
+    mDue.clear();
+    mTexts.clear();
+    // Texts are pointed to once they stop moving.
+    std::vector<size_t> textEvents;
+    base::TimeDelta due;
+    while (!in.atEnd()) {
+        InputEvent event;
+        memset(&event, 0, sizeof(event));
+        event.type = (InputEvent::Type)in.varint();
+        due += base::TimeDelta::FromMicroseconds(in.varint());
+        switch (event.type) {
+          case InputEvent::MOUSE_MOVED:
+            event.mouseMoved.x = in.signedVarint();
+            event.mouseMoved.y = in.signedVarint();
+            break;
+          case InputEvent::MOUSE_BUTTON:
+            event.mouseButton.buttonID = in.varint();
+            event.mouseButton.down = in.varint() != 0;
+            break;
+          case InputEvent::MOUSE_WHEEL:
+            event.mouseWheel.xScroll = in.signedVarint();
+            event.mouseWheel.yScroll = in.signedVarint();
+            break;
+          case InputEvent::KEY_EVENT:
+            event.keyEvent.pressed = in.varint() != 0;
+            event.keyEvent.mods = in.signedVarint();
+            event.keyEvent.vk_code = in.signedVarint();
+            event.keyEvent.scancode = in.signedVarint();
+            break;
+          case InputEvent::TEXT_EVENT: {
+            unsigned long long length = in.varint();
+            std::wstring text;
+            for (unsigned long long i = 0; i < length && in.ok(); ++i) {
+                text.push_back((wchar_t)in.varint());
+            }
+            textEvents.push_back(mEvents.size());
+            mTexts.push_back(text);
+            break;
+          }
+          default:
+            return false;
+        }
+        if (!in.ok()) {
+            return false;
+        }
+        mEvents.push_back(event);
+        mDue.push_back(due);
+    }
+    for (size_t i = 0; i < textEvents.size(); ++i) {
+        InputEvent &event = mEvents[textEvents[i]];
+        event.textEvent.text = mTexts[i].data();
+        event.textEvent.length = mTexts[i].length();
+    }
+    mStats.events = mEvents.size();
+    return true;
+}
+
+void InputReplayer::start(double speed, base::TimeTicks now) {
+    mSpeed = speed > 0 ? speed : 0;
+    mStart = now;
+    mNext = 0;
+    mInjected.assign(mEvents.size(), base::TimeTicks());
+    mWaiting.assign(mEvents.size(), false);
+    mNumWaiting = 0;
+}
+
+base::TimeDelta InputReplayer::inject(WindowImpl *win, base::TimeTicks now) {
+    size_t first = mNext;
+    while (mNext < mEvents.size() &&
+           (!mSpeed || (now - mStart).InMicroseconds() * mSpeed >=
+                           mDue[mNext].InMicroseconds())) {
+        mInjected[mNext] = now;
+        mWaiting[mNext] = true;
+        ++mNumWaiting;
+        ++mNext;
+    }
+    if (mNext > first) {
+        // The ACKs may come back from inside, so everything injected is
+        // marked waiting beforehand.
+        win->injectReplayed(&mEvents[first], mNext - first, first);
+        mStats.injected = mNext;
+    }
+    if (mNext == mEvents.size()) {
+        return base::TimeDelta::FromMicroseconds(-1);
+    }
+    base::TimeTicks due = mStart + base::TimeDelta::FromMicroseconds(
+        (int64)(mDue[mNext].InMicroseconds() / mSpeed));
+    return due - now;
+}
+
+void InputReplayer::onInputPainted(int first, int last,
+                                   base::TimeTicks now) {
+    for (int i = first; i <= last && i < (int)mNext; ++i) {
+        if (i < 0 || !mWaiting[i]) {
+            continue;
+        }
+        mWaiting[i] = false;
+        --mNumWaiting;
+        double latency = (now - mInjected[i]).InSecondsF();
+        mPainted.push_back(i);
+        mLatencies.push_back(latency);
+        ++mStats.painted;
+        mStats.totalLatency += latency;
+        if (latency > mStats.maxLatency) {
+            mStats.maxLatency = latency;
+        }
+    }
+}
+
+void InputReplayer::onInputUnpainted(int first, int last) {
+    for (int i = first; i <= last && i < (int)mNext; ++i) {
+        if (i < 0 || !mWaiting[i]) {
+            continue;
+        }
+        mWaiting[i] = false;
+        --mNumWaiting;
+        ++mStats.unpainted;
+    }
+}
+
+void InputReplayer::takePainted(std::vector<size_t> *painted,
+                                std::vector<double> *latencies) {
+    painted->swap(mPainted);
+    latencies->swap(mLatencies);
+    mPainted.clear();
+    mLatencies.clear();
+}
+
+bool InputReplayer::isFinished() const {
+    return mNext == mEvents.size() && !mNumWaiting;
+}
+
+void InputReplayer::finish() {
+    onInputUnpainted(0, (int)mNext - 1);
+}
+
+}
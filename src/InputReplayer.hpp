@@ -0,0 +1,122 @@
+/*  Berkelium Implementation
+ *  InputReplayer.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _BERKELIUM_INPUTREPLAYER_HPP_
+#define _BERKELIUM_INPUTREPLAYER_HPP_
+
+#include "berkelium/InputEvent.hpp"
+#include "berkelium/Stats.hpp"
+#include "base/time.h"
+
+#include <string>
+#include <vector>
+
+class FilePath;
+
+namespace Berkelium {
+
+class WindowImpl;
+
+/** Plays back a log written by InputRecorder, see
+ *  Window::startInputReplay. Each event's latency runs from injecting it
+ *  until the paint after the renderer's ACK of it, which the RenderWidgets
+ *  report back through WindowImpl. An event merged into a later one
+ *  before being sent shares the later one's ACK.
+ */
+class InputReplayer {
+public:
+    InputReplayer();
+
+    /** Reads the whole log. */
+    bool load(const FilePath &path);
+
+    /** \param speed  How many times faster than recorded, 0 for all at
+     *     once.
+     */
+    void start(double speed, base::TimeTicks now);
+
+    /** Injects every event that is due into win.
+     * \returns how long until the next one is, or a negative delay once
+     *     all were injected.
+     */
+    base::TimeDelta inject(WindowImpl *win, base::TimeTicks now);
+
+    /** The paint after the ACK of events first to last was delivered.
+     *  Those still waiting get their latency, kept until takePainted.
+     */
+    void onInputPainted(int first, int last, base::TimeTicks now);
+
+    /** Events first to last won't be painted: dropped, or nothing came
+     *  in time after their ACK.
+     */
+    void onInputUnpainted(int first, int last);
+
+    /** Moves out the events painted since the last call.
+     * \param painted  Receives the indices of those events.
+     * \param latencies  Receives their latencies, in seconds.
+     */
+    void takePainted(std::vector<size_t> *painted,
+                     std::vector<double> *latencies);
+
+    /** All events injected, and none waiting for a paint. */
+    bool isFinished() const;
+
+    /** Gives up on the events still waiting for a paint. */
+    void finish();
+
+    const InputReplayStats &getStats() const {
+        return mStats;
+    }
+
+private:
+    std::vector<InputEvent> mEvents;
+    // When each event is due, relative to the start at speed 1.
+    std::vector<base::TimeDelta> mDue;
+    std::vector<std::wstring> mTexts;
+
+    double mSpeed;
+    base::TimeTicks mStart;
+    size_t mNext;
+    std::vector<base::TimeTicks> mInjected;
+    // Of the injected events, those neither painted nor given up on.
+    std::vector<bool> mWaiting;
+    size_t mNumWaiting;
+    std::vector<size_t> mPainted;
+    std::vector<double> mLatencies;
+    InputReplayStats mStats;
+};
+
+}
+
+#endif
@@ -35,7 +35,11 @@
 #include "berkelium/Window.hpp"
 #include "RenderWidget.hpp"
 #include "MemoryRenderViewHost.hpp"
+#include "PaintFrameImpl.hpp"
+#include "TileDamageFilter.hpp"
+#include "Root.hpp"
 #include <stdio.h>
+#include <string.h>
 
 #include "chrome/browser/renderer_host/render_widget_host_view.h"
 #include "chrome/browser/renderer_host/render_process_host.h"
@@ -70,6 +74,11 @@ void MemoryRenderViewHost::OnMessageReceived(const IPC::Message& msg) {
   IPC_END_MESSAGE_MAP_EX()
       ;
 
+  // Once RenderWidgetHost has seen it too, so it is ready for more.
+  if (msg.type() == ViewHostMsg_HandleInputEvent_ACK::ID) {
+    Memory_OnInputEventAck(msg);
+  }
+
   if (!msg_is_ok) {
     // The message had a handler, but its de-serialization failed.
     // Kill the renderer.
@@ -110,6 +119,11 @@ void MemoryRenderWidgetHost::OnMessageReceived(const IPC::Message& msg) {
   IPC_END_MESSAGE_MAP_EX()
       ;
 
+  // Once RenderWidgetHost has seen it too, so it is ready for more.
+  if (msg.type() == ViewHostMsg_HandleInputEvent_ACK::ID) {
+    Memory_OnInputEventAck(msg);
+  }
+
   if (!msg_is_ok) {
     // The message had a handler, but its de-serialization failed.
     // Kill the renderer.
@@ -127,41 +141,133 @@ void MemoryRenderWidgetHost::Memory_OnMsgUpdateRect(const ViewHostMsg_UpdateRect
 }
 
 template <class T> void MemoryRenderHostImpl<T>::init() {
+    // The renderer is created with a size, and acks it with its first paint.
     mResizeAckPending=true;
+    mResizeQueued=false;
+    memset(&mResizeStats, 0, sizeof(mResizeStats));
+    memset(&mPaintStats, 0, sizeof(mPaintStats));
     mWidget=NULL;
-    
+    mFrame = new PaintFrameImpl;
+    PaintFrameImpl::registerAckStats(this->process()->id(), this->routing_id(),
+                                     &mPaintStats);
+    mDamageFilter = NULL;
+}
+template <class T> MemoryRenderHostImpl<T>::~MemoryRenderHostImpl() {
+    // A delegate may still be holding the last paint; its ACK must not
+    // find our stats anymore.
+    PaintFrameImpl::unregisterAckStats(this->process()->id(),
+                                       this->routing_id());
+    mFrame->detach();
+    delete mDamageFilter;
+}
+template <class T> void MemoryRenderHostImpl<T>::Memory_OnInputEventAck(
+    const IPC::Message& msg) {
+    RenderWidget *wid = static_cast<RenderWidget*>(this->view());
+    if (!wid) {
+        return;
+    }
+    // Same layout RenderWidgetHost::OnMsgInputEventAck reads.
+    void* iter = NULL;
+    int type = 0;
+    if (!msg.ReadInt(&iter, &type)) {
+        type = WebKit::WebInputEvent::Undefined;
+    }
+    wid->onInputEventAck(type);
 }
 template <class T> void MemoryRenderHostImpl<T>::Memory_WasResized() {
-    if (this->mResizeAckPending || !this->process()->HasConnection() || !this->view() || !this->renderer_initialized_) {
+    ++mResizeStats.requested;
+    if (mResizeQueued) {
+        ++mResizeStats.coalesced;
+    }
+    // Only the latest size matters; it is read from the view when sent.
+    mResizeQueued = true;
+    Memory_SendQueuedResize();
+}
+template <class T> void MemoryRenderHostImpl<T>::Memory_SendQueuedResize() {
+    // Whatever stops us here, the next UpdateRect tries again.
+    if (!mResizeQueued || this->mResizeAckPending ||
+        !this->process()->HasConnection() || !this->view() ||
+        !this->renderer_initialized_) {
         return;
     }
-    
+    // Before the first paint there is no size to compare with yet.
+    if (current_size_ == gfx::Size()) {
+        return;
+    }
+
     gfx::Rect view_bounds = this->view()->GetViewBounds();
     gfx::Size new_size(view_bounds.width(), view_bounds.height());
-    
+    mResizeQueued = false;
+
     // Avoid asking the RenderWidget to resize to its current size, since it
     // won't send us a PaintRect message in that case.
-    if (new_size == current_size_ || current_size_== gfx::Size())
-        return;
-    
-    if (mInFlightSize != gfx::Size())
+    if (new_size == current_size_)
         return;
-    
+
     // We don't expect to receive an ACK when the requested size is empty.
     if (!new_size.IsEmpty())
         mResizeAckPending = true;
-    
+
     if (!this->process()->Send(new ViewMsg_Resize(this->routing_id(), new_size,
-                                            this->GetRootWindowResizerRect())))
+                                            this->GetRootWindowResizerRect()))) {
         mResizeAckPending = false;
-    else
-        mInFlightSize = new_size;
+        mResizeQueued = true;
+        return;
+    }
+    mInFlightSize = new_size;
+    mResizeSentTime = base::TimeTicks::Now();
+    ++mResizeStats.sent;
+}
+template <class T> void MemoryRenderHostImpl<T>::Memory_ResetResize() {
+    mResizeAckPending = false;
+    mInFlightSize.SetSize(0, 0);
+    // Make sure the next renderer ends up at the view's size.
+    mResizeQueued = true;
+}
+template <class T> void MemoryRenderHostImpl<T>::Memory_RendererGone() {
+    if (mFrame->inUse()) {
+        mFrame->copyPixels();
+        Memory_ReplaceFrame();
+    }
+}
+template <class T> void MemoryRenderHostImpl<T>::Memory_ReplaceFrame() {
+    // No ACK is owed for it anymore: the renderer it came from is gone.
+    mFrame->detach();
+    mFrame = new PaintFrameImpl;
+}
+template <class T> void MemoryRenderHostImpl<T>::Memory_Repaint() {
+    // Before the first paint there is nothing to repaint: the whole view is
+    // on its way anyway.
+    if (!this->process()->HasConnection() || current_size_.IsEmpty()) {
+        return;
+    }
+    // Whoever asked wants every pixel again, unchanged or not.
+    if (mDamageFilter) {
+        mDamageFilter->reset();
+    }
+    this->process()->Send(new ViewMsg_Repaint(this->routing_id(), current_size_));
+}
+template <class T> void MemoryRenderHostImpl<T>::Memory_SetDamageFilter(
+    bool enabled, int tileSize)
+{
+    if (mDamageFilter && (!enabled || mDamageFilter->tileSize() != tileSize)) {
+        delete mDamageFilter;
+        mDamageFilter = NULL;
+    }
+    if (enabled && !mDamageFilter) {
+        mDamageFilter = new TileDamageFilter(tileSize);
+        mDamageRects.reserve(32);
+    }
 }
 template <class T> void MemoryRenderHostImpl<T>::Memory_OnMsgUpdateRect(
     const ViewHostMsg_UpdateRect_Params&params)
 {
   current_size_ = params.view_size;
 
+    if (this->view()) {
+        static_cast<RenderWidget*>(this->view())->onUpdateRect();
+    }
+
     DCHECK(!params.bitmap_rect.IsEmpty());
     DCHECK(!params.view_size.IsEmpty());
 
@@ -170,13 +276,28 @@ template <class T> void MemoryRenderHostImpl<T>::Memory_OnMsgUpdateRect(
 
     // resize_ack_pending_ needs to be cleared before we call DidPaintRect, since
     // that will end up reaching GetBackingStore.
-    if (is_resize_ack) {
-        assert(mResizeAckPending);
+    // After Memory_ResetResize the renderer may still ack its initial size.
+    if (is_resize_ack && mResizeAckPending) {
         mResizeAckPending=false;
         mInFlightSize.SetSize(0,0);
         //PRIV//DCHECK(resize_ack_pending_);
         //PRIV//resize_ack_pending_ = false;
         //PRIV//in_flight_size_.SetSize(0, 0);
+        if (!mResizeSentTime.is_null()) {
+            double latency = (base::TimeTicks::Now() - mResizeSentTime).InSecondsF();
+            mResizeSentTime = base::TimeTicks();
+            ++mResizeStats.acked;
+            mResizeStats.lastLatency = latency;
+            mResizeStats.totalLatency += latency;
+            if (latency > mResizeStats.maxLatency) {
+                mResizeStats.maxLatency = latency;
+            }
+            if (!mWidget) {
+                mWindow->onResizeComplete(params.view_size.width(),
+                                          params.view_size.height(),
+                                          latency);
+            }
+        }
     }
 
 
@@ -185,6 +306,22 @@ template <class T> void MemoryRenderHostImpl<T>::Memory_OnMsgUpdateRect(
 
   const size_t size = params.bitmap_rect.height() *
                       params.bitmap_rect.width() * 4;
+  PaintStats &totals = Root::getSingleton().getPaintTotals();
+  ++mPaintStats.updateRects;
+  ++totals.updateRects;
+  mPaintStats.bytesCopied += size;
+  totals.bytesCopied += size;
+
+  // Hold the frame while painting. Releasing it sends the ACK, unless a
+  // delegate took its own reference to read the bitmap later.
+  // Only a paint of an earlier renderer can still be held here; the
+  // current one waits for its ACK. Never refill a frame under its reader.
+  if (mFrame->inUse()) {
+    Memory_ReplaceFrame();
+  }
+  mFrame->setAckTarget(this->process()->id(), this->routing_id());
+  mFrame->addRef();
+
   TransportDIB* dib = this->process()->GetTransportDIB(params.bitmap);
   if (dib) {
     if (dib->size() < size) {
@@ -204,8 +341,9 @@ template <class T> void MemoryRenderHostImpl<T>::Memory_OnMsgUpdateRect(
   // ACK early so we can prefetch the next PaintRect if there is a next one.
   // This must be done AFTER we're done painting with the bitmap supplied by the
   // renderer. This ACK is a signal to the renderer that the backing store can
-  // be re-used, so the bitmap may be invalid after this call.
-  this->process()->Send(new ViewMsg_UpdateRect_ACK(this->routing_id()));
+  // be re-used, so the bitmap may be invalid after this call. If a delegate
+  // kept the frame, the ACK goes out when it releases it instead.
+  mFrame->release();
 
   // Now paint the view. Watch out: it might be destroyed already.
   if (this->view()) {
@@ -222,9 +360,10 @@ template <class T> void MemoryRenderHostImpl<T>::Memory_OnMsgUpdateRect(
     gfx::Rect view_bounds = this->view()->GetViewBounds();
     if (current_size_.width() != view_bounds.width() ||
         current_size_.height() != view_bounds.height()) {
-      Memory_WasResized();
+      mResizeQueued = true;
     }
   }
+  Memory_SendQueuedResize();
 
 }
 
@@ -236,29 +375,40 @@ template <class T> void MemoryRenderHostImpl<T>::Memory_PaintBackingStoreRect(
     int dx, int dy,
     const gfx::Rect& clip_rect)
 {
-    Rect updateRect;
-    updateRect.setFromRect(bitmap_rect);
-
-    Rect clipRect;
-    clipRect.setFromRect(clip_rect);
-
-    size_t numCopyRects = copy_rects.size();
-    Rect * copyRects = new Rect [numCopyRects];
-
-    for (size_t i = 0; i < numCopyRects; ++i) {
-        copyRects[i].setFromRect(copy_rects[i]);
+    const std::vector<gfx::Rect> *rects = &copy_rects;
+    if (mDamageFilter) {
+        bool damaged = mDamageFilter->filter(
+            static_cast<const unsigned char*>(bitmap->memory()),
+            bitmap_rect, copy_rects, view_size, dx, dy, clip_rect,
+            &mDamageRects);
+        if (!damaged) {
+            // Same pixels as last time: not worth waking the delegate.
+            return;
+        }
+        rects = &mDamageRects;
     }
+    mFrame->update(bitmap, bitmap_rect, *rects, view_size,
+                   dx, dy, clip_rect);
 
-    mWindow->onPaint(
-        mWidget,
-        static_cast<const unsigned char *>(bitmap->memory()),
-        updateRect,
-        numCopyRects,
-        copyRects,
-        dx,
-        dy,
-        clipRect);
-
+    double pixels = 0;
+    for (size_t i = 0; i < rects->size(); ++i) {
+        pixels += (double)(*rects)[i].width() * (*rects)[i].height();
+    }
+    int scrolls = (dx || dy) ? 1 : 0;
+    base::TimeTicks start = base::TimeTicks::Now();
+
+    mWindow->onPaint(mWidget, mFrame);
+
+    double elapsed = (base::TimeTicks::Now() - start).InSecondsF();
+    PaintStats &totals = Root::getSingleton().getPaintTotals();
+    mPaintStats.copyRects += rects->size();
+    totals.copyRects += rects->size();
+    mPaintStats.pixels += pixels;
+    totals.pixels += pixels;
+    mPaintStats.scrolls += scrolls;
+    totals.scrolls += scrolls;
+    mPaintStats.delegateTime += elapsed;
+    totals.delegateTime += elapsed;
 }
 
 /*
@@ -35,25 +35,15 @@
 
 #include "chrome/browser/renderer_host/render_view_host.h"
 #include "chrome/browser/renderer_host/render_view_host_factory.h"
+#include "berkelium/Stats.hpp"
+#include "base/time.h"
 
 class RenderWidgetHostView;
 namespace Berkelium {
 class WindowImpl;
 class RenderWidget;
-
-class MemoryRenderHostBase {
-    MemoryRenderHostBase() {}
-    virtual ~MemoryRenderHostBase() {}
-
-    virtual void Memory_OnMsgUpdateRect(const ViewHostMsg_UpdateRect_Params&params)=0;
-    virtual void Memory_PaintBackingStoreRect(TransportDIB* bitmap,
-                                      const gfx::Rect& bitmap_rect,
-                                      const std::vector<gfx::Rect>& copy_rects,
-                                      const gfx::Size& view_size,
-                                      int dx, int dy,
-                                      const gfx::Rect& clip_rect)=0;
-
-};
+class PaintFrameImpl;
+class TileDamageFilter;
 
 template <class RenderXHost> class MemoryRenderHostImpl: public RenderXHost {
     void init();
@@ -61,23 +51,49 @@ protected:
     template<class A, class B, class C, class D> MemoryRenderHostImpl(A a, B b, C c, D d):RenderXHost(a,b,c,d) {init();}
     template<class A, class B, class C> MemoryRenderHostImpl(A a, B b, C c):RenderXHost(a,b,c) {init();}
     template<class A, class B> MemoryRenderHostImpl(A a, B b):RenderXHost(a,b) {   init();}
-    ~MemoryRenderHostImpl() {}
+    ~MemoryRenderHostImpl();
 
 public:
+    // Asks for the view's current size. Sizes requested while the renderer
+    // is still busy with a resize are collapsed into the latest one.
     void Memory_WasResized();
+    // Forgets the resize in flight, for when the renderer went away.
+    void Memory_ResetResize();
+    // Lets go of a paint a delegate still holds, copying its pixels out of
+    // the dead renderer's memory first. Before Chromium frees that memory.
+    void Memory_RendererGone();
+    const ResizeStats &Memory_GetResizeStats() const { return mResizeStats; }
+    const PaintStats &Memory_GetPaintStats() const { return mPaintStats; }
+    void Memory_Repaint();
+    void Memory_OnInputEventAck(const IPC::Message& msg);
+    void Memory_SetDamageFilter(bool enabled, int tileSize);
     void Memory_OnMsgUpdateRect(const ViewHostMsg_UpdateRect_Params&params);
-    virtual void Memory_PaintBackingStoreRect(TransportDIB* bitmap,
+    // Not virtual: this runs for every UpdateRect, and nothing overrides it.
+    void Memory_PaintBackingStoreRect(TransportDIB* bitmap,
                                       const gfx::Rect& bitmap_rect,
                                       const std::vector<gfx::Rect>& copy_rects,
                                       const gfx::Size& view_size,
                                       int dx, int dy,
                                       const gfx::Rect& clip_rect);
 protected:
+    void Memory_SendQueuedResize();
+    // Detaches mFrame, for whoever still holds it, and starts a new one.
+    void Memory_ReplaceFrame();
+
     WindowImpl *mWindow;
     RenderWidget *mWidget;
     gfx::Size current_size_;
     bool mResizeAckPending;
     gfx::Size mInFlightSize;
+    // A size is waiting to be sent.
+    bool mResizeQueued;
+    base::TimeTicks mResizeSentTime;
+    ResizeStats mResizeStats;
+    PaintStats mPaintStats;
+    PaintFrameImpl *mFrame;
+    // NULL unless the damage filter is on.
+    TileDamageFilter *mDamageFilter;
+    std::vector<gfx::Rect> mDamageRects;
 };
 
 class MemoryRenderWidgetHost : public MemoryRenderHostImpl<RenderWidgetHost> {
@@ -0,0 +1,176 @@
+/*  Berkelium Implementation
+ *  PaintDispatcher.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/PaintFrame.hpp"
+#include "PaintDispatcher.hpp"
+#include "WindowImpl.hpp"
+
+#include "base/message_loop.h"
+#include "base/sys_info.h"
+#include "base/task.h"
+#include "base/thread.h"
+
+#include <sstream>
+
+namespace Berkelium {
+
+PaintQueue::PaintQueue(WindowImpl *window, MessageLoop *loop)
+    : mLoop(loop), mWindow(window), mScheduled(false),
+      mDelivering(false), mDeliveringWidget(NULL), mDelivered(&mLock) {
+    // A page and a popup widget at most, before the renderers wait for ACKs.
+    mJobs.reserve(4);
+}
+
+PaintQueue::~PaintQueue() {
+    DCHECK(mJobs.empty());
+}
+
+void PaintQueue::post(WindowDelegate *delegate, Widget *wid, PaintFrame *frame,
+                      PixelFormat format, bool deferredAck) {
+    Job job;
+    job.delegate = delegate;
+    job.widget = wid;
+    job.frame = frame;
+    job.format = format;
+    job.deferredAck = deferredAck;
+    frame->addRef();
+
+    AutoLock lock(mLock);
+    mJobs.push_back(job);
+    if (!mScheduled) {
+        mScheduled = true;
+        mLoop->PostTask(FROM_HERE, NewRunnableMethod(this, &PaintQueue::run));
+    }
+}
+
+void PaintQueue::run() {
+    while (true) {
+        Job job;
+        WindowImpl *window;
+        {
+            AutoLock lock(mLock);
+            if (mJobs.empty() || !mWindow) {
+                mScheduled = false;
+                return;
+            }
+            job = mJobs.front();
+            mJobs.erase(mJobs.begin());
+            window = mWindow;
+            mDelivering = true;
+            mDeliveringWidget = job.widget;
+        }
+        window->callPaintDelegate(job.delegate, job.widget, job.frame,
+                                  job.format, job.deferredAck);
+        {
+            AutoLock lock(mLock);
+            mDelivering = false;
+            mDeliveringWidget = NULL;
+            mDelivered.Broadcast();
+        }
+        // Acknowledges the renderer from here, unless the delegate kept it.
+        job.frame->release();
+    }
+}
+
+void PaintQueue::waitForDelivery(Widget *wid) {
+    while (mDelivering && (!wid || mDeliveringWidget == wid)) {
+        mDelivered.Wait();
+    }
+}
+
+bool PaintQueue::cancel() {
+    AutoLock lock(mLock);
+    bool dropped = !mJobs.empty();
+    for (size_t i = 0; i < mJobs.size(); ++i) {
+        mJobs[i].frame->release();
+    }
+    mJobs.clear();
+    mWindow = NULL;
+    waitForDelivery(NULL);
+    return dropped;
+}
+
+void PaintQueue::dropWidget(Widget *wid) {
+    AutoLock lock(mLock);
+    for (size_t i = 0; i < mJobs.size(); ) {
+        if (mJobs[i].widget == wid) {
+            mJobs[i].frame->release();
+            mJobs.erase(mJobs.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+    waitForDelivery(wid);
+}
+
+PaintDispatcher::PaintDispatcher()
+    : mNumThreads(0), mNextThread(0) {
+}
+
+PaintDispatcher::~PaintDispatcher() {
+    // Windows cancel their queues when destroyed, so whatever is still
+    // posted only finds empty queues.
+    for (size_t i = 0; i < mThreads.size(); ++i) {
+        mThreads[i]->Stop();
+        delete mThreads[i];
+    }
+}
+
+void PaintDispatcher::setNumThreads(int numThreads) {
+    mNumThreads = numThreads > 0 ? numThreads : 0;
+}
+
+PaintQueue *PaintDispatcher::createQueue(WindowImpl *window) {
+    if (mThreads.empty()) {
+        int count = mNumThreads;
+        if (!count) {
+            count = base::SysInfo::NumberOfProcessors();
+        }
+        for (int i = 0; i < count; ++i) {
+            std::ostringstream name;
+            name << "BerkeliumPaint" << i;
+            base::Thread *thread = new base::Thread(name.str().c_str());
+            if (!thread->Start()) {
+                delete thread;
+                break;
+            }
+            mThreads.push_back(thread);
+        }
+        CHECK(!mThreads.empty());
+    }
+    base::Thread *thread = mThreads[mNextThread++ % mThreads.size()];
+    return new PaintQueue(window, thread->message_loop());
+}
+
+}
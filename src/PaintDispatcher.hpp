@@ -0,0 +1,142 @@
+/*  Berkelium Implementation
+ *  PaintDispatcher.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_PAINTDISPATCHER_HPP_
+#define _BERKELIUM_PAINTDISPATCHER_HPP_
+
+#include "berkelium/PixelConvert.hpp"
+#include "base/condition_variable.h"
+#include "base/lock.h"
+#include "base/ref_counted.h"
+
+#include <vector>
+
+class MessageLoop;
+namespace base {
+class Thread;
+}
+
+namespace Berkelium {
+
+class WindowImpl;
+class WindowDelegate;
+class Widget;
+class PaintFrame;
+
+/** Paints of one Window waiting for a paint thread, see
+ *  Window::setThreadedPaint. Every Window is bound to a single thread, so
+ *  its paints are delivered in order while different Windows run in
+ *  parallel. Each queued paint keeps a reference to its PaintFrame, so the
+ *  renderer is only acknowledged once the delegate is done with it.
+ */
+class PaintQueue : public base::RefCountedThreadSafe<PaintQueue> {
+public:
+    PaintQueue(WindowImpl *window, MessageLoop *loop);
+
+    /** Queues a paint. The delegate, format and ack mode are captured now,
+     *  since the Window may change them before the paint runs. UI thread.
+     */
+    void post(WindowDelegate *delegate, Widget *wid, PaintFrame *frame,
+              PixelFormat format, bool deferredAck);
+
+    /** Drops pending paints and waits for one in progress, after which the
+     *  Window is never called again. No lock is held while a delegate
+     *  runs, but one that waits for the UI thread still can't finish while
+     *  this waits for it. UI thread.
+     *  \returns whether any paint was dropped.
+     */
+    bool cancel();
+
+    /** Drops the pending paints of a Widget about to be destroyed, and
+     *  waits if one of its paints is in progress. UI thread.
+     */
+    void dropWidget(Widget *wid);
+
+private:
+    friend class base::RefCountedThreadSafe<PaintQueue>;
+    ~PaintQueue();
+
+    struct Job {
+        WindowDelegate *delegate;
+        Widget *widget;
+        PaintFrame *frame;
+        PixelFormat format;
+        bool deferredAck;
+    };
+
+    void run();
+
+    // Waits until no paint of wid, or of any widget if NULL, is being
+    // delivered. mLock must be held.
+    void waitForDelivery(Widget *wid);
+
+    MessageLoop *mLoop;
+
+    // Guards everything below. Never held while calling the delegate.
+    Lock mLock;
+    WindowImpl *mWindow;
+    std::vector<Job> mJobs;
+    bool mScheduled;
+
+    // Set while run() is calling the delegate outside of mLock.
+    bool mDelivering;
+    Widget *mDeliveringWidget;
+    // Signalled when a delivery ends.
+    ConditionVariable mDelivered;
+};
+
+/** Owns the paint threads. Lives in Root; threads start with the first
+ *  queue.
+ */
+class PaintDispatcher {
+public:
+    PaintDispatcher();
+    ~PaintDispatcher();
+
+    /** Number of threads to start, 0 for one per processor. Has no effect
+     *  once the threads are running.
+     */
+    void setNumThreads(int numThreads);
+
+    /** A queue on the next thread in turn. */
+    PaintQueue *createQueue(WindowImpl *window);
+
+private:
+    int mNumThreads;
+    std::vector<base::Thread*> mThreads;
+    size_t mNextThread;
+};
+
+}
+
+#endif
@@ -0,0 +1,244 @@
+/*  Berkelium Implementation
+ *  PaintFrameImpl.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/Stats.hpp"
+#include "PaintFrameImpl.hpp"
+#include "RectUtil.hpp"
+#include "Root.hpp"
+
+#include "base/task.h"
+#include "chrome/browser/browser_thread.h"
+#include "chrome/browser/renderer_host/render_process_host.h"
+#include "chrome/common/render_messages.h"
+#include "chrome/common/transport_dib.h"
+
+namespace Berkelium {
+
+namespace {
+// Enough for nearly every paint we've seen; more just grows the vector once.
+const size_t kReservedCopyRects = 32;
+
+// PaintStats of the hosts still alive, by process and routing id. An ACK
+// may go out after its host is gone, so this is how it finds out.
+// UI thread only.
+std::map<std::pair<int, int>, PaintStats*> gAckStats;
+}
+
+PaintFrameImpl::PaintFrameImpl() {
+    // The owning host holds the first reference.
+    mRefCount = 1;
+    mProcessId = -1;
+    mRoutingId = MSG_ROUTING_NONE;
+    mDeliveryFormat = PIXEL_FORMAT_BGRA;
+    mCopyRectStorage.reserve(kReservedCopyRects);
+    mClipStorage.reserve(kReservedCopyRects);
+    mScrollPieces.reserve(kReservedCopyRects);
+    mScrollScratch.reserve(kReservedCopyRects);
+}
+
+PaintFrameImpl::~PaintFrameImpl() {
+}
+
+void PaintFrameImpl::addRef() {
+    base::subtle::NoBarrier_AtomicIncrement(&mRefCount, 1);
+}
+
+void PaintFrameImpl::release() {
+    // Copy the target first: once the count is decremented another thread
+    // may drop the last reference and delete us.
+    int routingId = base::subtle::Acquire_Load(&mRoutingId);
+    int processId = base::subtle::Acquire_Load(&mProcessId);
+    base::TimeTicks received = mReceived;
+    base::subtle::Atomic32 left =
+        base::subtle::Barrier_AtomicIncrement(&mRefCount, -1);
+    if (left == 0) {
+        delete this;
+    } else if (left == 1) {
+        sendAck(processId, routingId, base::TimeTicks::Now() - received);
+    }
+}
+
+bool PaintFrameImpl::inUse() const {
+    return base::subtle::Acquire_Load(&mRefCount) > 1;
+}
+
+void PaintFrameImpl::setAckTarget(int processId, int routingId) {
+    mReceived = base::TimeTicks::Now();
+    base::subtle::Release_Store(&mProcessId, processId);
+    base::subtle::Release_Store(&mRoutingId, routingId);
+}
+
+void PaintFrameImpl::detach() {
+    base::subtle::Release_Store(&mProcessId, -1);
+    base::subtle::Release_Store(&mRoutingId, MSG_ROUTING_NONE);
+    release();
+}
+
+void PaintFrameImpl::copyPixels() {
+    if (!mBuffer) {
+        return;
+    }
+    size_t size = (size_t)mBufferRect.width() * mBufferRect.height() * 4;
+    mOwnedPixels.assign(mBuffer, mBuffer + size);
+    mBuffer = mOwnedPixels.empty() ? NULL : &mOwnedPixels[0];
+}
+
+bool PaintFrameImpl::clipCopyRects(const Rect *interest, size_t numInterest,
+                                   bool *scrollDropped) {
+    *scrollDropped = false;
+    mClipStorage.clear();
+    for (size_t i = 0; i < mCopyRectStorage.size(); ++i) {
+        for (size_t j = 0; j < numInterest; ++j) {
+            Rect r = mCopyRectStorage[i].intersect(interest[j]);
+            if (!isEmptyRect(r)) {
+                mClipStorage.push_back(r);
+            }
+        }
+    }
+    if (!mClipStorage.empty()) {
+        // Adjacent interest rects split copy rects; glue them back.
+        mClipStorage.resize(coalesceRects(&mClipStorage[0],
+                                          mClipStorage.size(), 0, 0));
+    }
+    mCopyRectStorage.swap(mClipStorage);
+    mNumCopyRects = mCopyRectStorage.size();
+    mCopyRects = mNumCopyRects ? &mCopyRectStorage[0] : NULL;
+
+    // The delegate only has the interest region, so the scroll may only
+    // stay if every pixel it moves into the region comes from inside it.
+    bool scrollVisible = false;
+    bool scrollValid = true;
+    if (mDx || mDy) {
+        Rect moved = mScrollRect.intersect(mScrollRect.translate(mDx, mDy));
+        for (size_t j = 0; j < numInterest && scrollValid; ++j) {
+            Rect dest = moved.intersect(interest[j]);
+            if (isEmptyRect(dest)) {
+                continue;
+            }
+            scrollVisible = true;
+            mScrollPieces.clear();
+            mScrollPieces.push_back(dest.translate(-mDx, -mDy));
+            for (size_t k = 0; k < numInterest && !mScrollPieces.empty(); ++k) {
+                mScrollScratch.clear();
+                for (size_t p = 0; p < mScrollPieces.size(); ++p) {
+                    subtractRect(mScrollPieces[p], interest[k],
+                                 &mScrollScratch);
+                }
+                mScrollPieces.swap(mScrollScratch);
+            }
+            scrollValid = mScrollPieces.empty();
+        }
+    }
+    if (!scrollVisible || !scrollValid) {
+        // Nothing in this paint has the pixels the scroll would have
+        // brought in, so the caller has to ask for them again.
+        *scrollDropped = scrollVisible;
+        mDx = mDy = 0;
+        mScrollRect = Rect();
+        scrollVisible = false;
+    }
+    return mNumCopyRects || scrollVisible;
+}
+
+void PaintFrameImpl::update(
+    TransportDIB *bitmap,
+    const gfx::Rect &bitmap_rect,
+    const std::vector<gfx::Rect> &copy_rects,
+    const gfx::Size &view_size,
+    int dx, int dy,
+    const gfx::Rect &scroll_rect)
+{
+    mBuffer = static_cast<const unsigned char *>(bitmap->memory());
+    mBufferRect.setFromRect(bitmap_rect);
+
+    // Keeps its capacity, so steady-state paints don't allocate.
+    mCopyRectStorage.resize(copy_rects.size());
+    for (size_t i = 0; i < copy_rects.size(); ++i) {
+        mCopyRectStorage[i].setFromRect(copy_rects[i]);
+    }
+    mNumCopyRects = mCopyRectStorage.size();
+    mCopyRects = mNumCopyRects ? &mCopyRectStorage[0] : NULL;
+
+    mDx = dx;
+    mDy = dy;
+    mScrollRect.setFromRect(scroll_rect);
+    mViewWidth = view_size.width();
+    mViewHeight = view_size.height();
+}
+
+void PaintFrameImpl::sendAck(int processId, int routingId,
+                             base::TimeDelta latency) {
+    if (BrowserThread::CurrentlyOn(BrowserThread::UI)) {
+        sendAckOnUIThread(processId, routingId, latency);
+    } else {
+        BrowserThread::PostTask(
+            BrowserThread::UI, FROM_HERE,
+            NewRunnableFunction(&PaintFrameImpl::sendAckOnUIThread,
+                                processId, routingId, latency));
+    }
+}
+
+void PaintFrameImpl::registerAckStats(int processId, int routingId,
+                                      PaintStats *stats) {
+    gAckStats[std::make_pair(processId, routingId)] = stats;
+}
+
+void PaintFrameImpl::unregisterAckStats(int processId, int routingId) {
+    gAckStats.erase(std::make_pair(processId, routingId));
+}
+
+void PaintFrameImpl::sendAckOnUIThread(int processId, int routingId,
+                                       base::TimeDelta latency) {
+    // The host may be gone by now; the process lookup tells us whether
+    // there is still anyone to acknowledge.
+    RenderProcessHost *process = RenderProcessHost::FromID(processId);
+    if (!process) {
+        return;
+    }
+    process->Send(new ViewMsg_UpdateRect_ACK(routingId));
+
+    int64 ms = latency.InMilliseconds();
+    int bucket = 0;
+    while (bucket < PaintStats::ACK_BUCKETS - 1 && ms >= (1 << bucket)) {
+        ++bucket;
+    }
+    ++Root::getSingleton().getPaintTotals().ackLatency[bucket];
+    std::map<std::pair<int, int>, PaintStats*>::iterator iter =
+        gAckStats.find(std::make_pair(processId, routingId));
+    if (iter != gAckStats.end()) {
+        ++iter->second->ackLatency[bucket];
+    }
+}
+
+}
@@ -0,0 +1,157 @@
+/*  Berkelium Implementation
+ *  PaintFrameImpl.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_PAINTFRAMEIMPL_HPP_
+#define _BERKELIUM_PAINTFRAMEIMPL_HPP_
+
+#include "berkelium/PaintFrame.hpp"
+#include "berkelium/PixelConvert.hpp"
+#include "base/atomicops.h"
+#include "base/time.h"
+#include "gfx/rect.h"
+#include "gfx/size.h"
+
+#include <map>
+#include <vector>
+
+class TransportDIB;
+
+namespace Berkelium {
+
+struct PaintStats;
+
+/** The PaintFrame handed out by a MemoryRenderHostImpl. Each host owns one
+ *  and reuses it for every UpdateRect: the renderer won't send another paint
+ *  until the previous one was acknowledged, so the frame can never be
+ *  refilled while a delegate still holds it. A renderer that died doesn't
+ *  wait for that, so a held frame is copied and detached when it goes, and
+ *  the host starts over with a new one.
+ *
+ *  All per-paint storage lives here and keeps its capacity, so once warmed
+ *  up the paint path doesn't touch the heap.
+ *
+ *  The host keeps a permanent reference. Whenever the count drops back to
+ *  that single reference the paint is finished and ViewMsg_UpdateRect_ACK is
+ *  sent to the renderer.
+ */
+class PaintFrameImpl : public PaintFrame {
+public:
+    PaintFrameImpl();
+
+    virtual void addRef();
+    virtual void release();
+
+    /** True while anyone besides the owning host holds the frame. */
+    bool inUse() const;
+
+    /** Also starts the clock for PaintStats::ackLatency. UI thread only,
+     *  and only while no delegate holds the frame: the frame is handed out
+     *  afterwards, which publishes the new target to whoever releases it.
+     */
+    void setAckTarget(int processId, int routingId);
+
+    /** Drops the host's reference. Delegates which still hold the frame keep
+     *  it alive, but no acknowledgement is sent for it anymore. This one may
+     *  race with a release() on another thread, hence the atomic target.
+     */
+    void detach();
+
+    /** Copies the buffer into memory the frame owns, for when the shared
+     *  memory it points into is about to be freed. UI thread, before
+     *  detach().
+     */
+    void copyPixels();
+
+    /** Restricts the copy rects to the given areas. The scroll is kept
+     *  only if it moves pixels inside them from inside them; otherwise it
+     *  is dropped.
+     *  \param scrollDropped  Set if a scroll that reached into the areas
+     *      was dropped, leaving them stale until the next full repaint.
+     *  \returns whether anything is left to paint.
+     */
+    bool clipCopyRects(const Rect *interest, size_t numInterest,
+                       bool *scrollDropped);
+
+    /** The setPaintFormat format this paint is being delivered in, which
+     *  the default WindowDelegate::onPaintFrame converts to. Set on the
+     *  delivering thread just before the delegate is called.
+     */
+    void setDeliveryFormat(PixelFormat format) {
+        mDeliveryFormat = format;
+    }
+    PixelFormat getDeliveryFormat() const {
+        return mDeliveryFormat;
+    }
+
+    /** Where PaintStats::ackLatency of the host with these ids goes,
+     *  until it is unregistered from the host's destructor. UI thread.
+     */
+    static void registerAckStats(int processId, int routingId,
+                                 PaintStats *stats);
+    static void unregisterAckStats(int processId, int routingId);
+
+    void update(TransportDIB *bitmap,
+                const gfx::Rect &bitmap_rect,
+                const std::vector<gfx::Rect> &copy_rects,
+                const gfx::Size &view_size,
+                int dx, int dy,
+                const gfx::Rect &scroll_rect);
+
+private:
+    ~PaintFrameImpl();
+
+    static void sendAck(int processId, int routingId,
+                        base::TimeDelta latency);
+    static void sendAckOnUIThread(int processId, int routingId,
+                                  base::TimeDelta latency);
+
+    base::subtle::Atomic32 mRefCount;
+    // Stored process first, read routing first: whoever sees the routing
+    // id of detach() also sees its process id, and sends nothing.
+    base::subtle::Atomic32 mProcessId;
+    base::subtle::Atomic32 mRoutingId;
+    base::TimeTicks mReceived;
+    PixelFormat mDeliveryFormat;
+    std::vector<Rect> mCopyRectStorage;
+    // Swapped with mCopyRectStorage by clipCopyRects.
+    std::vector<Rect> mClipStorage;
+    // Scroll sources clipCopyRects hasn't found inside the interest yet.
+    std::vector<Rect> mScrollPieces;
+    std::vector<Rect> mScrollScratch;
+    // Only filled by copyPixels.
+    std::vector<unsigned char> mOwnedPixels;
+};
+
+}
+
+#endif
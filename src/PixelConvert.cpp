@@ -0,0 +1,354 @@
+/*  Berkelium Implementation
+ *  PixelConvert.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/PixelConvert.hpp"
+#include "PixelKernels.hpp"
+
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define BERKELIUM_PIXELCONVERT_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace Berkelium {
+
+namespace {
+
+#ifdef BERKELIUM_PIXELCONVERT_X86
+void cpuid(unsigned int leaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+    int r[4];
+    __cpuidex(r, leaf, 0);
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = r[i];
+    }
+#else
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Which register state the OS saves on context switches.
+unsigned long long xgetbv0() {
+#if defined(_MSC_FULL_VER) && _MSC_FULL_VER >= 160040219
+    return _xgetbv(0);
+#elif defined(_MSC_VER)
+    return 0;
+#else
+    unsigned int lo, hi;
+    // xgetbv, spelled out for assemblers that predate it.
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0"
+                         : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+// The best kernels this build has and this CPU runs.
+PixelKernels selectKernels() {
+    PixelKernels kernels;
+    memset(&kernels, 0, sizeof(kernels));
+    kernels.name = "scalar";
+#ifdef BERKELIUM_PIXELCONVERT_X86
+    unsigned int regs[4];
+    cpuid(0, regs);
+    unsigned int maxLeaf = regs[0];
+    cpuid(1, regs);
+    bool sse2 = (regs[3] & (1 << 26)) != 0;
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osxsave && avx && (xgetbv0() & 6) == 6) {
+        cpuid(7, regs);
+        avx2 = (regs[1] & (1 << 5)) != 0;
+    }
+    PixelKernels found;
+    if (avx2 && getAVX2Kernels(&found)) {
+        return found;
+    }
+    if (sse2 && getSSE2Kernels(&found)) {
+        return found;
+    }
+#endif
+    return kernels;
+}
+
+// Chosen while the library loads, before any thread can convert.
+PixelKernels gKernels = selectKernels();
+
+inline unsigned char clampByte(int x) {
+    return x < 0 ? 0 : (x > 255 ? 255 : (unsigned char)x);
+}
+
+inline int toY(int b, int g, int r) {
+    return ((kYR * r + kYG * g + kYB * b + 128) >> 8) + 16;
+}
+inline int toU(int b, int g, int r) {
+    return ((kUR * r + kUG * g + kUB * b + 128) >> 8) + 128;
+}
+inline int toV(int b, int g, int r) {
+    return ((kVR * r + kVG * g + kVB * b + 128) >> 8) + 128;
+}
+
+inline unsigned char average(unsigned char a, unsigned char b) {
+    return (unsigned char)((a + b + 1) >> 1);
+}
+
+// Writes dest[0..2] = unpremultiplied B,G,R of src, and returns alpha.
+// Kept bit-exact with the vector kernels: (c*255 + a/2) / a.
+inline unsigned char unpremultiply(const unsigned char *src,
+                                   unsigned char *dest) {
+    unsigned int a = src[3];
+    if (a == 255) {
+        dest[0] = src[0];
+        dest[1] = src[1];
+        dest[2] = src[2];
+    } else if (a == 0) {
+        dest[0] = dest[1] = dest[2] = 0;
+    } else {
+        for (int i = 0; i < 3; ++i) {
+            unsigned int c = (src[i] * 255 + (a >> 1)) / a;
+            dest[i] = c > 255 ? 255 : (unsigned char)c;
+        }
+    }
+    return (unsigned char)a;
+}
+
+void rowSwapRB(const unsigned char *src, unsigned char *dest, int count) {
+    int x = gKernels.swapRB ? gKernels.swapRB(src, dest, count) : 0;
+    for (; x < count; ++x) {
+        const unsigned char *s = src + x * 4;
+        unsigned char *d = dest + x * 4;
+        unsigned char b = s[0];
+        d[0] = s[2];
+        d[1] = s[1];
+        d[2] = b;
+        d[3] = s[3];
+    }
+}
+
+void rowUnpremultiply(const unsigned char *src, unsigned char *dest,
+                      int count, bool swapRB) {
+    int x = 0;
+    if (gKernels.unpremultiply) {
+        x = gKernels.unpremultiply(src, dest, count);
+        if (swapRB) {
+            rowSwapRB(dest, dest, x);
+        }
+    }
+    for (; x < count; ++x) {
+        const unsigned char *s = src + x * 4;
+        unsigned char *d = dest + x * 4;
+        unsigned char bgr[3];
+        d[3] = unpremultiply(s, bgr);
+        d[0] = bgr[swapRB ? 2 : 0];
+        d[1] = bgr[1];
+        d[2] = bgr[swapRB ? 0 : 2];
+    }
+}
+
+void rowRGB24(const unsigned char *src, unsigned char *dest, int count) {
+    int x = gKernels.rgb24 ? gKernels.rgb24(src, dest, count) : 0;
+    for (; x < count; ++x) {
+        const unsigned char *s = src + x * 4;
+        unsigned char *d = dest + x * 3;
+        d[0] = s[2];
+        d[1] = s[1];
+        d[2] = s[0];
+    }
+}
+
+void rowY(const unsigned char *src, unsigned char *dest, int count) {
+    int x = gKernels.lumaY ? gKernels.lumaY(src, dest, count) : 0;
+    for (; x < count; ++x) {
+        const unsigned char *s = src + x * 4;
+        dest[x] = clampByte(toY(s[0], s[1], s[2]));
+    }
+}
+
+// Chroma of block cx from a pair of rows. Source columns are clamped to
+// [left, right) so nothing outside the converted rect is read.
+inline void blockUV(const unsigned char *row0, const unsigned char *row1,
+                    unsigned char *destU, unsigned char *destV,
+                    int cx, int left, int right) {
+    int x0 = cx * 2 < left ? left : cx * 2;
+    int x1 = cx * 2 + 1 >= right ? right - 1 : cx * 2 + 1;
+    const unsigned char *a0 = row0 + x0 * 4, *a1 = row0 + x1 * 4;
+    const unsigned char *b0 = row1 + x0 * 4, *b1 = row1 + x1 * 4;
+    unsigned char px[3];
+    for (int i = 0; i < 3; ++i) {
+        px[i] = average(average(a0[i], b0[i]), average(a1[i], b1[i]));
+    }
+    destU[cx] = clampByte(toU(px[0], px[1], px[2]));
+    destV[cx] = clampByte(toV(px[0], px[1], px[2]));
+}
+
+// Chroma for the blocks [firstBlock, endBlock) of one pair of rows.
+void rowUV(const unsigned char *row0, const unsigned char *row1,
+           unsigned char *destU, unsigned char *destV,
+           int firstBlock, int endBlock, int left, int right) {
+    // Blocks entirely inside [left, right) go to the vector kernel.
+    int vectorBegin = (left + 1) / 2;
+    int vectorEnd = vectorBegin;
+    if (gKernels.chromaUV && right / 2 > vectorBegin) {
+        vectorEnd += gKernels.chromaUV(row0 + vectorBegin * 8,
+                                       row1 + vectorBegin * 8,
+                                       destU + vectorBegin,
+                                       destV + vectorBegin,
+                                       right / 2 - vectorBegin);
+    }
+    for (int cx = firstBlock; cx < endBlock; ++cx) {
+        if (cx == vectorBegin) {
+            cx = vectorEnd;
+            if (cx >= endBlock) {
+                break;
+            }
+        }
+        blockUV(row0, row1, destU, destV, cx, left, right);
+    }
+}
+
+void convertI420(const unsigned char *src, size_t srcStride,
+                 unsigned char *dest, int width, int height,
+                 const Rect &r) {
+    for (int y = r.top(); y < r.bottom(); ++y) {
+        rowY(src + y * srcStride + r.left() * 4,
+             dest + (size_t)y * width + r.left(), r.width());
+    }
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    unsigned char *planeU = dest + (size_t)width * height;
+    unsigned char *planeV = planeU + (size_t)chromaWidth * chromaHeight;
+    int firstBlock = r.left() / 2;
+    int endBlock = (r.right() + 1) / 2;
+    for (int cy = r.top() / 2; cy < (r.bottom() + 1) / 2; ++cy) {
+        int y0 = cy * 2 < r.top() ? r.top() : cy * 2;
+        int y1 = cy * 2 + 1 >= r.bottom() ? r.bottom() - 1 : cy * 2 + 1;
+        rowUV(src + y0 * srcStride, src + y1 * srcStride,
+              planeU + (size_t)cy * chromaWidth,
+              planeV + (size_t)cy * chromaWidth,
+              firstBlock, endBlock, r.left(), r.right());
+    }
+}
+
+}
+
+int PixelConvert::getBytesPerPixel(PixelFormat format) {
+    switch (format) {
+    case PIXEL_FORMAT_RGB24:
+        return 3;
+    case PIXEL_FORMAT_I420:
+        return 0;
+    default:
+        return 4;
+    }
+}
+
+size_t PixelConvert::getImageSize(PixelFormat format, int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+    if (format == PIXEL_FORMAT_I420) {
+        size_t chroma = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+        return (size_t)width * height + 2 * chroma;
+    }
+    return (size_t)width * height * getBytesPerPixel(format);
+}
+
+void PixelConvert::convert(PixelFormat format,
+                           const unsigned char *src, size_t srcStride,
+                           unsigned char *dest, int width, int height,
+                           const Rect &rect) {
+    Rect bounds;
+    bounds.mLeft = 0;
+    bounds.mTop = 0;
+    bounds.mWidth = width;
+    bounds.mHeight = height;
+    Rect r = rect.intersect(bounds);
+    if (r.width() <= 0 || r.height() <= 0) {
+        return;
+    }
+    if (format == PIXEL_FORMAT_I420) {
+        convertI420(src, srcStride, dest, width, height, r);
+        return;
+    }
+    size_t bpp = getBytesPerPixel(format);
+    size_t destStride = width * bpp;
+    for (int y = r.top(); y < r.bottom(); ++y) {
+        const unsigned char *s = src + y * srcStride + r.left() * 4;
+        unsigned char *d = dest + y * destStride + r.left() * bpp;
+        switch (format) {
+        case PIXEL_FORMAT_BGRA:
+            memcpy(d, s, r.width() * 4);
+            break;
+        case PIXEL_FORMAT_BGRA_UNPREMULTIPLIED:
+            rowUnpremultiply(s, d, r.width(), false);
+            break;
+        case PIXEL_FORMAT_RGBA:
+            rowSwapRB(s, d, r.width());
+            break;
+        case PIXEL_FORMAT_RGBA_UNPREMULTIPLIED:
+            rowUnpremultiply(s, d, r.width(), true);
+            break;
+        case PIXEL_FORMAT_RGB24:
+            rowRGB24(s, d, r.width());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void PixelConvert::convert(PixelFormat format,
+                           const unsigned char *src, size_t srcStride,
+                           unsigned char *dest, int width, int height,
+                           size_t numRects, const Rect *rects) {
+    for (size_t i = 0; i < numRects; ++i) {
+        convert(format, src, srcStride, dest, width, height, rects[i]);
+    }
+}
+
+bool PixelConvert::isAccelerated() {
+    return gKernels.swapRB != NULL;
+}
+
+const char *PixelConvert::getKernelName() {
+    return gKernels.name;
+}
+
+}
@@ -0,0 +1,76 @@
+/*  Berkelium Implementation
+ *  PixelKernels
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_PIXELKERNELS_HPP_
+#define _BERKELIUM_PIXELKERNELS_HPP_
+
+namespace Berkelium {
+
+// BT.601, studio range, 8 bit fixed point.
+const int kYR = 66, kYG = 129, kYB = 25;
+const int kUR = -38, kUG = -74, kUB = 112;
+const int kVR = 112, kVG = -94, kVB = -18;
+
+/** Vector row kernels for PixelConvert. Each one converts as many leading
+ *  pixels of a row as suit its vector width and returns how many; the
+ *  scalar code in PixelConvert.cpp does the rest, and every kernel is
+ *  bit-exact with it. A NULL kernel converts nothing.
+ *
+ *  Each instruction set lives in its own file, built with the compiler
+ *  flags it needs, and is only called once the CPU was found to have it.
+ */
+struct PixelKernels {
+    const char *name;
+    int (*swapRB)(const unsigned char *src, unsigned char *dest, int count);
+    /** Unpremultiplies, keeping the channel order. */
+    int (*unpremultiply)(const unsigned char *src, unsigned char *dest,
+                         int count);
+    /** BGRA to R,G,B bytes. */
+    int (*rgb24)(const unsigned char *src, unsigned char *dest, int count);
+    int (*lumaY)(const unsigned char *src, unsigned char *dest, int count);
+    /** U and V of count 2x2 blocks, whose left pixels start at row0 and
+     *  row1.
+     */
+    int (*chromaUV)(const unsigned char *row0, const unsigned char *row1,
+                    unsigned char *destU, unsigned char *destV, int count);
+};
+
+/** Fills in the kernels if this build has them.
+ *  \returns false if the compiler couldn't target the instruction set.
+ */
+bool getSSE2Kernels(PixelKernels *kernels);
+bool getAVX2Kernels(PixelKernels *kernels);
+
+}
+
+#endif
@@ -0,0 +1,199 @@
+/*  Berkelium Implementation
+ *  PixelKernelsAVX2
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "PixelKernels.hpp"
+
+#include <string.h>
+
+// Built with -mavx2 where the compiler knows it, see CMakeLists.txt.
+// MSVC takes the intrinsics without any flag from Visual Studio 2012 on.
+#if defined(__AVX2__) || (defined(_MSC_VER) && _MSC_VER >= 1700 && (defined(_M_IX86) || defined(_M_X64)))
+#define BERKELIUM_PIXELKERNELS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace Berkelium {
+
+#ifdef BERKELIUM_PIXELKERNELS_AVX2
+
+namespace {
+
+inline __m256i load8(const unsigned char *p) {
+    return _mm256_loadu_si256((const __m256i*)p);
+}
+
+int swapRB(const unsigned char *src, unsigned char *dest, int count) {
+    const __m256i order = _mm256_setr_epi8(
+        2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15,
+        2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15);
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        _mm256_storeu_si256((__m256i*)(dest + x * 4),
+                            _mm256_shuffle_epi8(load8(src + x * 4), order));
+    }
+    return x;
+}
+
+int rgb24(const unsigned char *src, unsigned char *dest, int count) {
+    // Each 128 bit lane packs its four pixels into 12 bytes.
+    const __m256i order = _mm256_setr_epi8(
+        2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1,
+        2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1);
+    int x = 0;
+    // The stores run 4 bytes past the 24 written, which the next two
+    // pixels overwrite.
+    for (; x + 10 <= count; x += 8) {
+        __m256i px = _mm256_shuffle_epi8(load8(src + x * 4), order);
+        unsigned char *d = dest + x * 3;
+        _mm_storeu_si128((__m128i*)d, _mm256_castsi256_si128(px));
+        _mm_storeu_si128((__m128i*)(d + 12),
+                         _mm256_extracti128_si256(px, 1));
+    }
+    return x;
+}
+
+// Two pixels widened to 32 bit lanes, one per 128 bit half.
+inline __m256i unpremultiplyPair(const unsigned char *src) {
+    __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+    __m256i a = _mm256_shuffle_epi32(c, _MM_SHUFFLE(3,3,3,3));
+    __m256i n = _mm256_add_epi32(_mm256_sub_epi32(_mm256_slli_epi32(c, 8), c),
+                                 _mm256_srli_epi32(a, 1));
+    // Same reasoning as the SSE2 version: truncation matches integer
+    // division, and a == 0 saturates to 0 when packed.
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(n),
+                                             _mm256_cvtepi32_ps(a)));
+}
+
+int unpremultiply(const unsigned char *src, unsigned char *dest, int count) {
+    const __m256i alphaMask = _mm256_set1_epi32(0xff000000);
+    // packs and packus work within 128 bit halves, which leaves the
+    // pixels in the order 0,2,4,6,1,3,5,7.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        const unsigned char *s = src + x * 4;
+        __m256i p0213 = _mm256_packs_epi32(unpremultiplyPair(s),
+                                           unpremultiplyPair(s + 8));
+        __m256i p4657 = _mm256_packs_epi32(unpremultiplyPair(s + 16),
+                                           unpremultiplyPair(s + 24));
+        __m256i out = _mm256_permutevar8x32_epi32(
+            _mm256_packus_epi16(p0213, p4657), order);
+        out = _mm256_or_si256(_mm256_andnot_si256(alphaMask, out),
+                              _mm256_and_si256(alphaMask, load8(s)));
+        _mm256_storeu_si256((__m256i*)(dest + x * 4), out);
+    }
+    return x;
+}
+
+// coef holds the 16 bit weights {b,g,r,0} four times. Returns the
+// weighted sums of the eight BGRA pixels in px, in order.
+inline __m256i dot8(__m256i px, __m256i coef) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(px, zero), coef);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(px, zero), coef);
+    return _mm256_hadd_epi32(lo, hi);
+}
+
+// ((sum + 128) >> 8) + bias, as eight bytes.
+inline void finish8(__m256i sum, int bias, unsigned char *dest) {
+    sum = _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8);
+    sum = _mm256_add_epi32(sum, _mm256_set1_epi32(bias));
+    sum = _mm256_packs_epi32(sum, sum);
+    sum = _mm256_packus_epi16(sum, sum);
+    int lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(sum));
+    int hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(sum, 1));
+    memcpy(dest, &lo, 4);
+    memcpy(dest + 4, &hi, 4);
+}
+
+inline __m256i weights(int b, int g, int r) {
+    return _mm256_setr_epi16(b, g, r, 0, b, g, r, 0,
+                             b, g, r, 0, b, g, r, 0);
+}
+
+int lumaY(const unsigned char *src, unsigned char *dest, int count) {
+    const __m256i coef = weights(kYB, kYG, kYR);
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        finish8(dot8(load8(src + x * 4), coef), 16, dest + x);
+    }
+    return x;
+}
+
+// Averages horizontal pairs of eight pixels into four, in the low half.
+inline __m128i averagePairs(__m256i px) {
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    px = _mm256_avg_epu8(px, _mm256_srli_epi64(px, 32));
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(px, even));
+}
+
+int chromaUV(const unsigned char *row0, const unsigned char *row1,
+             unsigned char *destU, unsigned char *destV, int count) {
+    const __m256i ucoef = weights(kUB, kUG, kUR);
+    const __m256i vcoef = weights(kVB, kVG, kVR);
+    int cx = 0;
+    for (; cx + 8 <= count; cx += 8) {
+        const unsigned char *a = row0 + cx * 8;
+        const unsigned char *b = row1 + cx * 8;
+        __m256i v0 = _mm256_avg_epu8(load8(a), load8(b));
+        __m256i v1 = _mm256_avg_epu8(load8(a + 32), load8(b + 32));
+        __m256i px = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(averagePairs(v0)), averagePairs(v1), 1);
+        finish8(dot8(px, ucoef), 128, destU + cx);
+        finish8(dot8(px, vcoef), 128, destV + cx);
+    }
+    return cx;
+}
+
+}
+
+bool getAVX2Kernels(PixelKernels *kernels) {
+    kernels->name = "AVX2";
+    kernels->swapRB = &swapRB;
+    kernels->unpremultiply = &unpremultiply;
+    kernels->rgb24 = &rgb24;
+    kernels->lumaY = &lumaY;
+    kernels->chromaUV = &chromaUV;
+    return true;
+}
+
+#else
+
+bool getAVX2Kernels(PixelKernels *) {
+    return false;
+}
+
+#endif
+
+}
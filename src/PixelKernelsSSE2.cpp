@@ -0,0 +1,185 @@
+/*  Berkelium Implementation
+ *  PixelKernelsSSE2
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "PixelKernels.hpp"
+
+#include <string.h>
+
+// Built with -msse2 on 32 bit x86, see CMakeLists.txt. MSVC takes the
+// intrinsics without any flag.
+#if defined(__SSE2__) || (defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64)))
+#define BERKELIUM_PIXELKERNELS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace Berkelium {
+
+#ifdef BERKELIUM_PIXELKERNELS_SSE2
+
+namespace {
+
+int swapRB(const unsigned char *src, unsigned char *dest, int count) {
+    const __m128i rbMask = _mm_set1_epi32(0x00ff00ff);
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        __m128i rb = _mm_and_si128(px, rbMask);
+        __m128i ga = _mm_andnot_si128(rbMask, px);
+        rb = _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16));
+        _mm_storeu_si128((__m128i*)(dest + x * 4), _mm_or_si128(rb, ga));
+    }
+    return x;
+}
+
+// One pixel widened to four 32 bit lanes.
+inline __m128i unpremultiplyPixel(__m128i c) {
+    __m128i a = _mm_shuffle_epi32(c, _MM_SHUFFLE(3,3,3,3));
+    __m128i n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(c, 8), c),
+                              _mm_srli_epi32(a, 1));
+    // The quotient is never within float error of the next integer, so
+    // truncating matches integer division. a == 0 gives inf or NaN, which
+    // converts to INT_MIN and saturates to 0 when packed.
+    return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(n),
+                                       _mm_cvtepi32_ps(a)));
+}
+
+int unpremultiply(const unsigned char *src, unsigned char *dest, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32(0xff000000);
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        __m128i p01 = _mm_packs_epi32(
+            unpremultiplyPixel(_mm_unpacklo_epi16(lo, zero)),
+            unpremultiplyPixel(_mm_unpackhi_epi16(lo, zero)));
+        __m128i p23 = _mm_packs_epi32(
+            unpremultiplyPixel(_mm_unpacklo_epi16(hi, zero)),
+            unpremultiplyPixel(_mm_unpackhi_epi16(hi, zero)));
+        __m128i out = _mm_packus_epi16(p01, p23);
+        out = _mm_or_si128(_mm_andnot_si128(alphaMask, out),
+                           _mm_and_si128(alphaMask, px));
+        _mm_storeu_si128((__m128i*)(dest + x * 4), out);
+    }
+    return x;
+}
+
+// coef holds the 16 bit weights {b,g,r,0} twice. Returns the weighted sum
+// of each of the four BGRA pixels in px as 32 bit lanes.
+inline __m128i dot4(__m128i px, __m128i coef) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), coef);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), coef);
+    lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+    hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+    lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3,1,2,0));
+    hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3,1,2,0));
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+// ((sum + 128) >> 8) + bias, as four bytes.
+inline int finish4(__m128i sum, int bias) {
+    sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+    sum = _mm_add_epi32(sum, _mm_set1_epi32(bias));
+    sum = _mm_packs_epi32(sum, sum);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+}
+
+inline __m128i weights(int b, int g, int r) {
+    return _mm_setr_epi16(b, g, r, 0, b, g, r, 0);
+}
+
+// Averages horizontal pairs of four pixels; the results land in 32 bit
+// lanes 0 and 1.
+inline __m128i averagePairs(__m128i px) {
+    px = _mm_avg_epu8(px, _mm_srli_epi64(px, 32));
+    return _mm_shuffle_epi32(px, _MM_SHUFFLE(3,1,2,0));
+}
+
+int lumaY(const unsigned char *src, unsigned char *dest, int count) {
+    const __m128i coef = weights(kYB, kYG, kYR);
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        int y = finish4(dot4(px, coef), 16);
+        memcpy(dest + x, &y, 4);
+    }
+    return x;
+}
+
+int chromaUV(const unsigned char *row0, const unsigned char *row1,
+             unsigned char *destU, unsigned char *destV, int count) {
+    const __m128i ucoef = weights(kUB, kUG, kUR);
+    const __m128i vcoef = weights(kVB, kVG, kVR);
+    int cx = 0;
+    for (; cx + 4 <= count; cx += 4) {
+        const unsigned char *a = row0 + cx * 8;
+        const unsigned char *b = row1 + cx * 8;
+        __m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)a),
+                                  _mm_loadu_si128((const __m128i*)b));
+        __m128i v1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(a + 16)),
+                                  _mm_loadu_si128((const __m128i*)(b + 16)));
+        __m128i px = _mm_unpacklo_epi64(averagePairs(v0), averagePairs(v1));
+        int u = finish4(dot4(px, ucoef), 128);
+        int v = finish4(dot4(px, vcoef), 128);
+        memcpy(destU + cx, &u, 4);
+        memcpy(destV + cx, &v, 4);
+    }
+    return cx;
+}
+
+}
+
+bool getSSE2Kernels(PixelKernels *kernels) {
+    kernels->name = "SSE2";
+    kernels->swapRB = &swapRB;
+    kernels->unpremultiply = &unpremultiply;
+    // SSE2 has no byte shuffle to drop every fourth byte with, and the
+    // scalar loop is already bound by memory bandwidth.
+    kernels->rgb24 = NULL;
+    kernels->lumaY = &lumaY;
+    kernels->chromaUV = &chromaUV;
+    return true;
+}
+
+#else
+
+bool getSSE2Kernels(PixelKernels *) {
+    return false;
+}
+
+#endif
+
+}
@@ -0,0 +1,143 @@
+/*  Berkelium Implementation
+ *  RectUtil.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "RectUtil.hpp"
+
+namespace Berkelium {
+
+namespace {
+
+typedef long long Area;
+
+inline Area area(const Rect &r) {
+    return isEmptyRect(r) ? 0 : (Area)r.width() * r.height();
+}
+
+// Pixels the bounding box of a and b covers that neither a nor b does.
+inline Area mergeCost(const Rect &a, const Rect &b) {
+    return area(unionRect(a, b)) - area(a) - area(b) + area(a.intersect(b));
+}
+
+}
+
+Rect unionRect(const Rect &a, const Rect &b) {
+    if (isEmptyRect(a)) return b;
+    if (isEmptyRect(b)) return a;
+    int left = a.left() < b.left() ? a.left() : b.left();
+    int top = a.top() < b.top() ? a.top() : b.top();
+    int right = a.right() > b.right() ? a.right() : b.right();
+    int bottom = a.bottom() > b.bottom() ? a.bottom() : b.bottom();
+    Rect ret;
+    ret.mLeft = left;
+    ret.mTop = top;
+    ret.mWidth = right - left;
+    ret.mHeight = bottom - top;
+    return ret;
+}
+
+void subtractRect(const Rect &r, const Rect &cut, std::vector<Rect> *out) {
+    if (isEmptyRect(r)) {
+        return;
+    }
+    Rect overlap = r.intersect(cut);
+    if (isEmptyRect(overlap)) {
+        out->push_back(r);
+        return;
+    }
+    Rect piece;
+    if (overlap.top() > r.top()) {
+        piece.mLeft = r.left();
+        piece.mTop = r.top();
+        piece.mWidth = r.width();
+        piece.mHeight = overlap.top() - r.top();
+        out->push_back(piece);
+    }
+    if (overlap.bottom() < r.bottom()) {
+        piece.mLeft = r.left();
+        piece.mTop = overlap.bottom();
+        piece.mWidth = r.width();
+        piece.mHeight = r.bottom() - overlap.bottom();
+        out->push_back(piece);
+    }
+    if (overlap.left() > r.left()) {
+        piece.mLeft = r.left();
+        piece.mTop = overlap.top();
+        piece.mWidth = overlap.left() - r.left();
+        piece.mHeight = overlap.height();
+        out->push_back(piece);
+    }
+    if (overlap.right() < r.right()) {
+        piece.mLeft = overlap.right();
+        piece.mTop = overlap.top();
+        piece.mWidth = r.right() - overlap.right();
+        piece.mHeight = overlap.height();
+        out->push_back(piece);
+    }
+}
+
+size_t coalesceRects(Rect *rects, size_t numRects,
+                     int perRectCost, size_t maxRects) {
+    size_t n = 0;
+    for (size_t i = 0; i < numRects; ++i) {
+        if (!isEmptyRect(rects[i])) {
+            rects[n++] = rects[i];
+        }
+    }
+    // Greedy: always take the cheapest merge. The lists coming out of a
+    // single paint are short, so the quadratic search is fine.
+    while (n > 1) {
+        size_t bestI = 0, bestJ = 1;
+        Area bestCost = mergeCost(rects[0], rects[1]);
+        for (size_t i = 0; i < n && bestCost > 0; ++i) {
+            for (size_t j = i + 1; j < n; ++j) {
+                Area cost = mergeCost(rects[i], rects[j]);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestI = i;
+                    bestJ = j;
+                    if (cost <= 0) break;
+                }
+            }
+        }
+        bool forced = maxRects && n > maxRects;
+        if (bestCost > 0 && bestCost >= perRectCost && !forced) {
+            break;
+        }
+        rects[bestI] = unionRect(rects[bestI], rects[bestJ]);
+        rects[bestJ] = rects[--n];
+    }
+    return n;
+}
+
+}
@@ -0,0 +1,68 @@
+/*  Berkelium Implementation
+ *  RectUtil.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_RECTUTIL_HPP_
+#define _BERKELIUM_RECTUTIL_HPP_
+
+#include "berkelium/Rect.hpp"
+#include <stddef.h>
+#include <vector>
+
+namespace Berkelium {
+
+inline bool isEmptyRect(const Rect &r) {
+    return r.width() <= 0 || r.height() <= 0;
+}
+
+/** Smallest rect containing both a and b. Empty rects are ignored. */
+Rect unionRect(const Rect &a, const Rect &b);
+
+/** Appends the parts of r outside of cut to out, as at most four disjoint
+ *  rects: full width bands above and below cut, then the pieces left and
+ *  right of it.
+ */
+void subtractRect(const Rect &r, const Rect &cut, std::vector<Rect> *out);
+
+/** Merges rects in place wherever the pixels added by the bounding box cost
+ *  less than handling another rect. Merges that add nothing (contained or
+ *  exactly adjacent rects) always happen, and if maxRects is non-zero the
+ *  cheapest remaining merges are forced until that many are left.
+ *  \param perRectCost  Cost of one rect, in pixels.
+ *  \returns the new number of rects
+ */
+size_t coalesceRects(Rect *rects, size_t numRects,
+                     int perRectCost, size_t maxRects);
+
+}
+
+#endif
@@ -31,6 +31,7 @@
  */
 
 #include "chrome/browser/renderer_host/backing_store_manager.h"
+#include "chrome/browser/renderer_host/render_process_host.h"
 #if defined(OS_LINUX)
 #include "webkit/glue/plugins/webplugin.h"
 #include "webkit/glue/plugins/gtk_plugin_container_manager.h"
@@ -39,16 +40,10 @@
 #include <gtk/gtkwindow.h>
 #endif
 
-#if defined (OS_WIN)
-#include <windows.h> // for GetTickCount()
-#elif defined (OS_POSIX)
-#include <sys/time.h>
-#include <time.h>
-#endif
-
 #include "base/utf_string_conversions.h"
 
 #include "berkelium/Platform.hpp"
+#include "berkelium/Berkelium.hpp"
 #include "RenderWidget.hpp"
 #include "WindowImpl.hpp"
 
@@ -62,8 +57,11 @@ void Widget::destroy(){
 
 RenderWidget::RenderWidget(WindowImpl *winImpl, int id) {
     mFocused = true;
+    mHidden = false;
     mBacking = NULL;
     mWindow = winImpl;
+    mInputAcksPending = 0;
+    mMovesInHost = 0;
 
     mMouseX=mMouseY=0;
     mModifiers=0;
@@ -77,11 +75,17 @@ int RenderWidget::getId() const {
 
 void RenderWidget::setHost(RenderWidgetHost *host) {
     mHost = host;
+    // Held input was meant for the old one.
+    resetInputQueue();
+    dropTracedInput();
 }
 
 void RenderWidget::setPos(int x, int y) {
     mRect.set_x(x);
     mRect.set_y(y);
+    if (mWindow) {
+        mWindow->onWidgetMoved(this);
+    }
 }
 
 Rect RenderWidget::getRect() const {
@@ -94,6 +98,7 @@ Rect RenderWidget::getRect() const {
 }
 
 RenderWidget::~RenderWidget() {
+    dropTracedInput();
     if (mBacking) {
         BackingStoreManager::RemoveBackingStore(mHost);
     }
@@ -112,10 +117,26 @@ RenderWidgetHost* RenderWidget::GetRenderWidgetHost() const{
 
   // Notifies the View that it has become visible.
 void RenderWidget::DidBecomeSelected(){
+    if (!mHidden) {
+        return;
+    }
+    mHidden = false;
+    if (mHost) {
+        mHost->WasRestored();
+    }
 }
 
   // Notifies the View that it has been hidden.
 void RenderWidget::WasHidden(){
+    if (mHidden) {
+        return;
+    }
+    mHidden = true;
+    // The renderer stops painting and its process gets backgrounded once
+    // all of its widgets are hidden.
+    if (mHost) {
+        mHost->WasHidden();
+    }
 }
 
   // Tells the View to size itself to the specified size.
@@ -410,25 +431,25 @@ bool RenderWidget::hasFocus() const {
     return mFocused;
 }
 
+// timestamp is in seconds of Berkelium::getInputTime(), 0 for now.
 template<class T>
-void zeroWebEvent(T &event, int modifiers, WebKit::WebInputEvent::Type t) {
+void zeroWebEvent(T &event, int modifiers, WebKit::WebInputEvent::Type t,
+                  double timestamp) {
     memset(&event,0,sizeof(T));
     event.type=t;
     event.size=sizeof(T);
     event.modifiers=modifiers;
-#ifdef _WIN32
-    event.timeStampSeconds=GetTickCount()/1000.0;
-#else
-    timeval tv;
-    gettimeofday(&tv,NULL);
-    event.timeStampSeconds=((double)tv.tv_usec)/1000000.0;
-    event.timeStampSeconds+=tv.tv_sec;
-#endif
+    event.timeStampSeconds=timestamp ? timestamp : Berkelium::getInputTime();
 }
 
 void RenderWidget::mouseMoved(int xPos, int yPos) {
+    mouseMoved(xPos, yPos, 0);
+}
+
+void RenderWidget::mouseMoved(int xPos, int yPos, double timestamp) {
     WebKit::WebMouseEvent event;
-    zeroWebEvent(event, mModifiers, WebKit::WebInputEvent::MouseMove);
+    zeroWebEvent(event, mModifiers, WebKit::WebInputEvent::MouseMove,
+                 timestamp);
 	event.x = xPos;
 	event.y = yPos;
 	event.globalX = xPos+mRect.x();
@@ -439,14 +460,17 @@ void RenderWidget::mouseMoved(int xPos, int yPos) {
 	event.button = (WebKit::WebMouseEvent::Button)mButton;
     event.clickCount = (mButton != (int32)WebKit::WebMouseEvent::ButtonNone);
 
-	if (GetRenderWidgetHost()) {
-		GetRenderWidgetHost()->ForwardMouseEvent(event);
-	}
+    queueMouseEvent(event);
 }
 
 void RenderWidget::mouseWheel(int scrollX, int scrollY) {
+    mouseWheel(scrollX, scrollY, 0);
+}
+
+void RenderWidget::mouseWheel(int scrollX, int scrollY, double timestamp) {
 	WebKit::WebMouseWheelEvent event;
-	zeroWebEvent(event, mModifiers, WebKit::WebInputEvent::MouseWheel);
+	zeroWebEvent(event, mModifiers, WebKit::WebInputEvent::MouseWheel,
+	             timestamp);
 	event.x = mMouseX;
 	event.y = mMouseY;
 	event.windowX = mMouseX; // PRHFIXME: Window vs Global position?
@@ -462,12 +486,15 @@ void RenderWidget::mouseWheel(int scrollX, int scrollY) {
 	event.button = (WebKit::WebMouseEvent::Button)mButton;
     event.clickCount = (mButton != (int32)WebKit::WebMouseEvent::ButtonNone);
 
-	if (GetRenderWidgetHost()) {
-		GetRenderWidgetHost()->ForwardWheelEvent(event);
-	}
+    queueWheelEvent(event);
 }
 
 void RenderWidget::mouseButton(unsigned int mouseButton, bool down) {
+    this->mouseButton(mouseButton, down, 0);
+}
+
+void RenderWidget::mouseButton(unsigned int mouseButton, bool down,
+                               double timestamp) {
     unsigned int buttonChangeMask=0;
     switch(mouseButton) {
       case 0:
@@ -486,7 +513,8 @@ void RenderWidget::mouseButton(unsigned int mouseButton, bool down) {
         mModifiers&=(~buttonChangeMask);
     }
     WebKit::WebMouseEvent event;
-    zeroWebEvent(event, mModifiers, down?WebKit::WebInputEvent::MouseDown:WebKit::WebInputEvent::MouseUp);
+    zeroWebEvent(event, mModifiers, down?WebKit::WebInputEvent::MouseDown:WebKit::WebInputEvent::MouseUp,
+                 timestamp);
     switch(mouseButton) {
       case 0:
         event.button = WebKit::WebMouseEvent::ButtonLeft;
@@ -510,14 +538,18 @@ void RenderWidget::mouseButton(unsigned int mouseButton, bool down) {
 	event.windowY = mMouseY;
 	event.globalX = mMouseX+mRect.x();
 	event.globalY = mMouseY+mRect.y();
-	if (GetRenderWidgetHost()) {
-		GetRenderWidgetHost()->ForwardMouseEvent(event);
-	}
+	sendMouseEvent(event, base::TimeTicks::Now());
 }
 
 void RenderWidget::keyEvent(bool pressed, int modifiers, int vk_code, int scancode){
+    keyEvent(pressed, modifiers, vk_code, scancode, 0);
+}
+
+void RenderWidget::keyEvent(bool pressed, int modifiers, int vk_code,
+                            int scancode, double timestamp) {
 	NativeWebKeyboardEvent event;
-	zeroWebEvent(event, mModifiers, pressed?WebKit::WebInputEvent::RawKeyDown:WebKit::WebInputEvent::KeyUp);
+	zeroWebEvent(event, mModifiers, pressed?WebKit::WebInputEvent::RawKeyDown:WebKit::WebInputEvent::KeyUp,
+	             timestamp);
 	event.windowsKeyCode = vk_code;
 	event.nativeKeyCode = scancode;
 	event.text[0]=0;
@@ -540,9 +572,7 @@ void RenderWidget::keyEvent(bool pressed, int modifiers, int vk_code, int scanco
 
 	event.setKeyIdentifierFromWindowsKeyCode();
 
-	if (GetRenderWidgetHost()) {
-		GetRenderWidgetHost()->ForwardKeyboardEvent(event);
-	}
+	sendKeyboardEvent(event, base::TimeTicks::Now());
 	// keep track of persistent modifiers.
     unsigned int test=(WebKit::WebInputEvent::LeftButtonDown|WebKit::WebInputEvent::MiddleButtonDown|WebKit::WebInputEvent::RightButtonDown);
 	mModifiers = ((mModifiers&test) |  (event.modifiers& (Berkelium::SHIFT_MOD|Berkelium::CONTROL_MOD|Berkelium::ALT_MOD|Berkelium::META_MOD)));
@@ -550,10 +580,10 @@ void RenderWidget::keyEvent(bool pressed, int modifiers, int vk_code, int scanco
 
 
 void RenderWidget::textEvent(const wchar_t * text, size_t textLength) {
-    textEvent(WideString::point_to(text, textLength));
+    textEvent(WideString::point_to(text, textLength), 0);
 }
 
-void RenderWidget::textEvent(WideString wideText) {
+void RenderWidget::textEvent(WideString wideText, double timestamp) {
 	// generate one of these events for each lengthCap chunks.
 	// 1 less because we need to null terminate.
     if (!GetRenderWidgetHost()) {
@@ -566,10 +596,22 @@ void RenderWidget::textEvent(WideString wideText) {
         return;
     }
 
+    size_t threshold = mWindow->getTextInsertThreshold();
+    if (threshold && text16.length() >= threshold) {
+        // One IPC and one layout instead of one per character.
+        flushInput();
+        GetRenderWidgetHost()->ImeConfirmComposition(text16);
+        ++mWindow->getMutableInputStats().textInserts;
+        traceSent(newTrace(WebKit::WebInputEvent::Undefined,
+                           base::TimeTicks::Now()), false);
+        return;
+    }
+    base::TimeTicks queued = base::TimeTicks::Now();
+
     // assert(WebKit::WebKeyboardEvent::textLengthCap > 2);
 
 	NativeWebKeyboardEvent event;
-	zeroWebEvent(event,mModifiers,WebKit::WebInputEvent::Char);
+	zeroWebEvent(event,mModifiers,WebKit::WebInputEvent::Char,timestamp);
 	event.isSystemKey = false;
 	event.windowsKeyCode = 0;
 	event.nativeKeyCode = 0;
@@ -586,8 +628,283 @@ void RenderWidget::textEvent(WideString wideText) {
             // Otherwise, only send one at a time.
             event.text[1] = event.unmodifiedText[1] = 0;
         }
-        GetRenderWidgetHost()->ForwardKeyboardEvent(event);
+        sendKeyboardEvent(event, queued);
 	}
 }
 
+void RenderWidget::queueMouseEvent(const WebKit::WebMouseEvent &event) {
+    InputStats &stats = mWindow->getMutableInputStats();
+    base::TimeTicks now = base::TimeTicks::Now();
+    if (!mInputAcksPending || !mWindow->isInputCoalescing()) {
+        sendMouseEvent(event, now);
+        return;
+    }
+    if (!mHeldInput.empty() &&
+        mHeldInput.back().type == WebKit::WebInputEvent::MouseMove) {
+        // Only the latest position matters.
+        ++stats.movesCoalesced;
+        static_cast<WebKit::WebMouseEvent&>(mHeldInput.back()) = event;
+        mergeTrace(&mHeldTrace.back());
+        return;
+    }
+    WebKit::WebMouseWheelEvent held;
+    static_cast<WebKit::WebMouseEvent&>(held) = event;
+    mHeldInput.push_back(held);
+    mHeldTrace.push_back(newTrace(event.type, now));
+}
+
+void RenderWidget::queueWheelEvent(const WebKit::WebMouseWheelEvent &event) {
+    InputStats &stats = mWindow->getMutableInputStats();
+    base::TimeTicks now = base::TimeTicks::Now();
+    if (!mInputAcksPending || !mWindow->isInputCoalescing()) {
+        sendWheelEvent(event, now);
+        return;
+    }
+    if (!mHeldInput.empty()) {
+        WebKit::WebMouseWheelEvent &last = mHeldInput.back();
+        if (last.type == WebKit::WebInputEvent::MouseWheel &&
+            last.modifiers == event.modifiers &&
+            last.scrollByPage == event.scrollByPage) {
+            ++stats.wheelsCoalesced;
+            WebKit::WebMouseWheelEvent sum = event;
+            sum.deltaX += last.deltaX;
+            sum.deltaY += last.deltaY;
+            sum.wheelTicksX += last.wheelTicksX;
+            sum.wheelTicksY += last.wheelTicksY;
+            last = sum;
+            mergeTrace(&mHeldTrace.back());
+            return;
+        }
+    }
+    mHeldInput.push_back(event);
+    mHeldTrace.push_back(newTrace(event.type, now));
+}
+
+void RenderWidget::sendMouseEvent(const WebKit::WebMouseEvent &event,
+                                  base::TimeTicks queued) {
+    flushInput();
+    if (hostTakesInput()) {
+        mHost->ForwardMouseEvent(event);
+        expectAck(event.type);
+        ++mWindow->getMutableInputStats().sent;
+        traceSent(newTrace(event.type, queued), true);
+    }
+}
+
+void RenderWidget::sendWheelEvent(const WebKit::WebMouseWheelEvent &event,
+                                  base::TimeTicks queued) {
+    flushInput();
+    if (hostTakesInput()) {
+        mHost->ForwardWheelEvent(event);
+        expectAck(event.type);
+        ++mWindow->getMutableInputStats().sent;
+        traceSent(newTrace(event.type, queued), true);
+    }
+}
+
+void RenderWidget::sendKeyboardEvent(const NativeWebKeyboardEvent &event,
+                                     base::TimeTicks queued) {
+    flushInput();
+    if (hostTakesInput()) {
+        mHost->ForwardKeyboardEvent(event);
+        expectAck(event.type);
+        ++mWindow->getMutableInputStats().sent;
+        traceSent(newTrace(event.type, queued), true);
+    }
+}
+
+void RenderWidget::flushInput() {
+    if (mHeldInput.empty()) {
+        return;
+    }
+    if (hostTakesInput()) {
+        for (size_t i = 0; i < mHeldInput.size(); ++i) {
+            const WebKit::WebMouseWheelEvent &event = mHeldInput[i];
+            if (event.type == WebKit::WebInputEvent::MouseWheel) {
+                mHost->ForwardWheelEvent(event);
+            } else {
+                mHost->ForwardMouseEvent(event);
+            }
+            expectAck(event.type);
+            traceSent(mHeldTrace[i], true);
+        }
+        mWindow->getMutableInputStats().sent += mHeldInput.size();
+    } else {
+        dropHeldTrace();
+    }
+    mHeldInput.clear();
+    mHeldTrace.clear();
+}
+
+void RenderWidget::onInputEventAck(int type) {
+    ++mWindow->getMutableInputStats().acked;
+    if (mInputAcksPending > 0) {
+        --mInputAcksPending;
+    }
+    if (type == WebKit::WebInputEvent::MouseMove && mMovesInHost > 0) {
+        --mMovesInHost;
+    }
+    // RenderWidgetHost may itself merge a mouse move into a later one;
+    // the later one's ACK stands for both.
+    base::TimeTicks now = base::TimeTicks::Now();
+    while (!mUnacked.empty()) {
+        TracedInput input = mUnacked.front();
+        mUnacked.pop_front();
+        input.acked = now;
+        mAcked.push_back(input);
+        if (input.type == type) {
+            break;
+        }
+    }
+    expireAcked();
+    flushInput();
+}
+
+void RenderWidget::onRendererGone() {
+    resetInputQueue();
+    // Nothing in flight will be acknowledged or painted now.
+    dropTracedInput();
+}
+
+bool RenderWidget::hostTakesInput() const {
+    // The same checks RenderWidgetHost makes before it drops an event.
+    return mHost && mHost->process()->HasConnection() &&
+        !mHost->ignore_input_events() &&
+        !mHost->process()->ignore_input_events();
+}
+
+void RenderWidget::expectAck(int type) {
+    if (type == WebKit::WebInputEvent::MouseMove) {
+        if (mMovesInHost == 2) {
+            // Replaces the move waiting in RenderWidgetHost; one ACK
+            // still stands for both.
+            return;
+        }
+        ++mMovesInHost;
+    }
+    ++mInputAcksPending;
+}
+
+void RenderWidget::resetInputQueue() {
+    dropHeldTrace();
+    mHeldInput.clear();
+    mHeldTrace.clear();
+    mInputAcksPending = 0;
+    mMovesInHost = 0;
+}
+
+TracedInput RenderWidget::newTrace(int type, base::TimeTicks queued) const {
+    TracedInput input;
+    input.id = 0;
+    input.type = type;
+    input.queued = queued;
+    input.replayFirst = input.replayLast = mWindow->getReplayIndex();
+    return input;
+}
+
+void RenderWidget::mergeTrace(TracedInput *held) const {
+    int index = mWindow->getReplayIndex();
+    if (index < 0) {
+        return;
+    }
+    if (held->replayFirst < 0) {
+        held->replayFirst = index;
+    }
+    held->replayLast = index;
+}
+
+void RenderWidget::traceSent(TracedInput input, bool needsAck) {
+    input.id = mWindow->getInputLatency().nextId();
+    if (needsAck) {
+        mUnacked.push_back(input);
+    } else {
+        input.acked = base::TimeTicks::Now();
+        mAcked.push_back(input);
+        expireAcked();
+    }
+}
+
+void RenderWidget::expireAcked() {
+    base::TimeTicks now = base::TimeTicks::Now();
+    base::TimeDelta maxWait = base::TimeDelta::FromMilliseconds(
+        InputLatencyTracker::kMaxPaintWaitMs);
+    size_t expired = 0;
+    while (expired < mAcked.size() &&
+           (now - mAcked[expired].acked >= maxWait ||
+            mAcked.size() - expired > InputLatencyTracker::MAX_WAITING)) {
+        reportUnpainted(mAcked[expired]);
+        ++expired;
+    }
+    mAcked.erase(mAcked.begin(), mAcked.begin() + expired);
+    if (!mAcked.empty() && !mAckedTimer.IsRunning()) {
+        mAckedTimer.Start(mAcked.front().acked + maxWait - now, this,
+                          &RenderWidget::expireAcked);
+    }
+}
+
+void RenderWidget::reportPainted(const TracedInput &input,
+                                 base::TimeTicks now) {
+    mWindow->getInputLatency().painted(input, now);
+    mWindow->replayInputPainted(input.replayFirst, input.replayLast, now);
+}
+
+void RenderWidget::reportUnpainted(const TracedInput &input) {
+    mWindow->getInputLatency().unpainted(input);
+    mWindow->replayInputUnpainted(input.replayFirst, input.replayLast);
+}
+
+void RenderWidget::onUpdateRect() {
+    // The renderer holds further paints until the last one is ACKed, so
+    // whatever is left from it was never delivered.
+    for (size_t i = 0; i < mPainting.size(); ++i) {
+        reportUnpainted(mPainting[i]);
+    }
+    mPainting.clear();
+    base::TimeTicks now = base::TimeTicks::Now();
+    base::TimeDelta maxWait = base::TimeDelta::FromMilliseconds(
+        InputLatencyTracker::kMaxPaintWaitMs);
+    for (size_t i = 0; i < mAcked.size(); ++i) {
+        if (now - mAcked[i].acked > maxWait) {
+            reportUnpainted(mAcked[i]);
+        } else {
+            mPainting.push_back(mAcked[i]);
+        }
+    }
+    mAcked.clear();
+}
+
+void RenderWidget::onPaintDelivered() {
+    if (mPainting.empty()) {
+        return;
+    }
+    base::TimeTicks now = base::TimeTicks::Now();
+    for (size_t i = 0; i < mPainting.size(); ++i) {
+        reportPainted(mPainting[i], now);
+    }
+    mPainting.clear();
+}
+
+void RenderWidget::dropHeldTrace() {
+    // Never sent, so only a replay waits for it.
+    for (size_t i = 0; i < mHeldTrace.size(); ++i) {
+        mWindow->replayInputUnpainted(mHeldTrace[i].replayFirst,
+                                      mHeldTrace[i].replayLast);
+    }
+}
+
+void RenderWidget::dropTracedInput() {
+    for (size_t i = 0; i < mUnacked.size(); ++i) {
+        reportUnpainted(mUnacked[i]);
+    }
+    for (size_t i = 0; i < mAcked.size(); ++i) {
+        reportUnpainted(mAcked[i]);
+    }
+    for (size_t i = 0; i < mPainting.size(); ++i) {
+        reportUnpainted(mPainting[i]);
+    }
+    mUnacked.clear();
+    mAcked.clear();
+    mPainting.clear();
+}
+
 }
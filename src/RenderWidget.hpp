@@ -39,7 +39,12 @@
 #if defined(OS_MACOSX)
 #include "chrome/browser/renderer_host/accelerated_surface_container_manager_mac.h"#
 #endif
+#include "base/timer.h"
 #include "gfx/rect.h"
+#include "InputLatencyTracker.hpp"
+
+#include <deque>
+#include <vector>
 //see chrome/browser/renderer_host/test/test_render_view_host.h for a stub impl.
 
 namespace Berkelium {
@@ -69,7 +74,27 @@ public:
 
     Rect getRect() const;
 
-    void textEvent(WideString text);
+    // Same as the Widget methods, with the time of the event in seconds
+    // of Berkelium::getInputTime(), or 0 for now.
+    void mouseMoved(int xPos, int yPos, double timestamp);
+    void mouseButton(uint32 buttonID, bool down, double timestamp);
+    void mouseWheel(int xScroll, int yScroll, double timestamp);
+    void keyEvent(bool pressed, int mods, int vk_code, int scancode,
+                  double timestamp);
+    void textEvent(WideString text, double timestamp);
+
+    // The renderer is done with the oldest input event we sent, whose
+    // WebInputEvent::Type is given.
+    void onInputEventAck(int type);
+    // An UpdateRect arrived; its paint carries the acknowledged input.
+    void onUpdateRect();
+    // That paint reached the delegate.
+    void onPaintDelivered();
+    // Sends the held back mouse moves and wheel events.
+    void flushInput();
+    // The renderer died: nothing in flight will be acknowledged or painted
+    // anymore, so its latency samples are dropped as unpainted.
+    void onRendererGone();
 
 public: /******* RenderWidgetHostView *******/
 
@@ -230,6 +255,42 @@ public: /******* RenderWidgetHostView *******/
   virtual bool ContainsNativeView(gfx::NativeView native_view) const;
 
 private:
+    void queueMouseEvent(const WebKit::WebMouseEvent &event);
+    void queueWheelEvent(const WebKit::WebMouseWheelEvent &event);
+    // Flushes held events first, so that input stays in order. queued is
+    // when the event came in, for the latency tracking.
+    void sendMouseEvent(const WebKit::WebMouseEvent &event,
+                        base::TimeTicks queued);
+    void sendWheelEvent(const WebKit::WebMouseWheelEvent &event,
+                        base::TimeTicks queued);
+    void sendKeyboardEvent(const NativeWebKeyboardEvent &event,
+                           base::TimeTicks queued);
+    // Whether mHost passes input on to the renderer, rather than dropping
+    // it without an ACK.
+    bool hostTakesInput() const;
+    // Counts an event mHost just took towards the ACKs we wait for.
+    void expectAck(int type);
+    // Forgets held input and the ACKs outstanding.
+    void resetInputQueue();
+    // How to follow an event that came in at queued, with the replay
+    // event mWindow is injecting, if any.
+    TracedInput newTrace(int type, base::TimeTicks queued) const;
+    // Adds the replay event mWindow is injecting to a held one.
+    void mergeTrace(TracedInput *held) const;
+    // Starts following an event that was just sent.
+    void traceSent(TracedInput input, bool needsAck);
+    // Hands a finished event to the latency stats and to the replay.
+    void reportPainted(const TracedInput &input, base::TimeTicks now);
+    void reportUnpainted(const TracedInput &input);
+    // Gives up on acknowledged events no paint came for in time, so a
+    // page that never repaints doesn't collect them. Runs from
+    // mAckedTimer too.
+    void expireAcked();
+    // Tells a replay that the held events won't be painted.
+    void dropHeldTrace();
+    // Forgets the events in flight, counting them as unpainted.
+    void dropTracedInput();
+
     uint32 mModifiers;
     int32 mButton;
     int32 mMouseX;
@@ -237,12 +298,34 @@ private:
 
     RenderWidgetHost *mHost;
     bool mFocused;
+    bool mHidden;
     BackingStore* mBacking;
     int mId;
     std::wstring mTooltip;
 
     WindowImpl* mWindow;
 
+    // Input events sent that the renderer hasn't acknowledged yet.
+    int mInputAcksPending;
+    // Mouse moves in RenderWidgetHost: one in flight, and at most one
+    // waiting behind it that newer moves replace without an ACK.
+    int mMovesInHost;
+    // Mouse moves and wheel events held back meanwhile, oldest first.
+    // Moves are stored in the WebMouseEvent part.
+    std::vector<WebKit::WebMouseWheelEvent> mHeldInput;
+    // How each held event will be followed once sent; queued is when the
+    // first of the events merged into it came in.
+    std::vector<TracedInput> mHeldTrace;
+
+    // Input sent and waiting for its ACK, oldest first.
+    std::deque<TracedInput> mUnacked;
+    // Acknowledged input waiting for the next UpdateRect, oldest first.
+    std::vector<TracedInput> mAcked;
+    // Fires when the oldest of mAcked has waited too long.
+    base::OneShotTimer<RenderWidget> mAckedTimer;
+    // Input in the paint of the last UpdateRect, until it is delivered.
+    std::vector<TracedInput> mPainting;
+
     gfx::Rect mRect;
 
 #if defined(OS_MACOSX)
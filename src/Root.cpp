@@ -34,6 +34,8 @@
 #include "berkelium/Berkelium.hpp"
 #include "Root.hpp"
 #include "MemoryRenderViewHost.hpp"
+#include "PaintDispatcher.hpp"
+#include "FrameBufferBudget.hpp"
 
 // Chromium headers
 #include "base/message_loop.h"
@@ -68,6 +70,7 @@
 #include "chrome/common/logging_chrome.h"
 #include "base/logging.h"
 #include <signal.h>
+#include <string.h>
 #include <sys/stat.h>
 #if defined(OS_MACOSX)
 #include "base/mac_util.h"
@@ -312,6 +315,7 @@ Root::Root (FileString homeDirectory) {
     mTimerMgr.reset(new HighResolutionTimerManager);
     mUIThread.reset(new BrowserThread(BrowserThread::UI, mMessageLoop.get()));
     mErrorHandler = 0;
+    memset(&mPaintTotals, 0, sizeof(mPaintTotals));
 
     mProcessSingleton.reset(new ProcessSingleton(homedirpath));
     BrowserProcessImpl *browser_process;
@@ -404,6 +408,8 @@ Root::Root (FileString homeDirectory) {
   CHECK(icu_result);
 
     mRenderViewHostFactory.reset(new MemoryRenderViewHostFactory);
+    mPaintDispatcher.reset(new PaintDispatcher);
+    mFrameBufferBudget.reset(new FrameBufferBudget);
     
 //    mNotificationService=new NotificationService();
 //    ChildProcess* coreProcess=new ChildProcess;
@@ -489,6 +495,8 @@ Root::~Root(){
     //g_browser_process->profile_manager()->RemoveProfile(mProf);
 
     g_browser_process->EndSession();
+    mPaintDispatcher.reset();
+    mFrameBufferBudget.reset();
     mRenderViewHostFactory.reset();
     mTimerMgr.reset();
     mSysMon.reset();
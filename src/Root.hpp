@@ -34,6 +34,7 @@
 #include "berkelium/Platform.hpp"
 #include "berkelium/Berkelium.hpp"
 #include "berkelium/Singleton.hpp"
+#include "berkelium/Stats.hpp"
 #include "chrome/browser/profile.h"
 #include "chrome/common/notification_service.h"
 #include "base/ref_counted.h"
@@ -55,6 +56,8 @@ namespace Berkelium {
 
 class MemoryRenderViewHostFactory;
 class ErrorDelegate;
+class PaintDispatcher;
+class FrameBufferBudget;
 
 //singleton class that contains chromium singletons. Not visible outside of Berkelium library core
 class Root : public AutoSingleton<Root> {
@@ -70,6 +73,9 @@ class Root : public AutoSingleton<Root> {
     scoped_ptr<MemoryRenderViewHostFactory> mRenderViewHostFactory;
     base::ScopedNSAutoreleasePool mAutoreleasePool;
     scoped_refptr<HistogramSynchronizer> mHistogramSynchronizer;
+    scoped_ptr<PaintDispatcher> mPaintDispatcher;
+    scoped_ptr<FrameBufferBudget> mFrameBufferBudget;
+    PaintStats mPaintTotals;
 
     ErrorDelegate* mErrorHandler;
 public:
@@ -97,6 +103,19 @@ public:
 
     static void SetUpGLibLogHandler();
 
+    PaintDispatcher *getPaintDispatcher() {
+        return mPaintDispatcher.get();
+    }
+
+    FrameBufferBudget *getFrameBufferBudget() {
+        return mFrameBufferBudget.get();
+    }
+
+    // Every host adds its paints here as well as to its own counters.
+    PaintStats &getPaintTotals() {
+        return mPaintTotals;
+    }
+
     URLRequestContextGetter *getDefaultRequestContext() {
         return mDefaultRequestContext;
     }
@@ -0,0 +1,278 @@
+/*  Berkelium Implementation
+ *  SharedFrameExport.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/FrameBuffer.hpp"
+#include "berkelium/SharedFrame.hpp"
+#include "SharedFrameExport.hpp"
+#include "RectUtil.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <string.h>
+
+namespace Berkelium {
+
+SharedFrameExport::SharedFrameExport()
+    : mBase(NULL), mSize(0), mHeader(NULL), mNumSlots(0), mNext(0),
+      mSequence(0), mPublishedWidth(0), mPublishedHeight(0) {
+}
+
+SharedFrameExport::~SharedFrameExport() {
+    close();
+}
+
+#if BERKELIUM_PLATFORM != PLATFORM_WINDOWS
+
+namespace {
+// Pixels start on a cache line.
+const size_t kPixelAlignment = 64;
+
+void addRects(std::vector<Rect> *to, size_t numRects, const Rect *rects) {
+    to->insert(to->end(), rects, rects + numRects);
+    if (to->size() > SharedFrameHeader::MAX_DIRTY_RECTS) {
+        to->resize(coalesceRects(&(*to)[0], to->size(), 0,
+                                 SharedFrameHeader::MAX_DIRTY_RECTS));
+    }
+}
+
+// Whether name is an export whose writer is provably gone: it closed the
+// segment, or its process no longer exists. Anything else, including a
+// writer still setting the segment up or someone else's segment, may be
+// in use.
+bool isStale(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 &&
+        (size_t)st.st_size >= sizeof(SharedFrameHeader)) {
+        base = mmap(NULL, sizeof(SharedFrameHeader), PROT_READ, MAP_SHARED,
+                    fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    const SharedFrameHeader *head = static_cast<SharedFrameHeader*>(base);
+    bool stale = false;
+    if (head->magic == SharedFrameHeader::MAGIC &&
+        head->version == SharedFrameHeader::VERSION) {
+        stale = head->closed ||
+            (head->writerPid > 0 && kill(head->writerPid, 0) != 0 &&
+             errno == ESRCH);
+    }
+    munmap(base, sizeof(SharedFrameHeader));
+    return stale;
+}
+}
+
+bool SharedFrameExport::open(const std::string &name, int maxWidth,
+                             int maxHeight, int numSlots) {
+    close();
+    if (maxWidth <= 0 || maxHeight <= 0 || numSlots <= 0) {
+        return false;
+    }
+    size_t slotBytes = (size_t)maxWidth * maxHeight * 4;
+    size_t pixelOffset = sizeof(SharedFrameHeader) +
+        numSlots * sizeof(SharedFrameSlot);
+    pixelOffset = (pixelOffset + kPixelAlignment - 1) &
+        ~(kPixelAlignment - 1);
+    size_t size = pixelOffset + numSlots * slotBytes;
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST && isStale(name)) {
+        // Left over from a writer that crashed; it may have another size.
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd < 0) {
+        return false;
+    }
+    void *base = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    mName = name;
+    mBase = static_cast<unsigned char*>(base);
+    mSize = size;
+    mHeader = static_cast<SharedFrameHeader*>(base);
+    // ftruncate zeroed everything, so all slots start out unlocked.
+    mHeader->version = SharedFrameHeader::VERSION;
+    mHeader->numSlots = numSlots;
+    mHeader->slotBytes = slotBytes;
+    mHeader->pixelOffset = pixelOffset;
+    mHeader->maxWidth = maxWidth;
+    mHeader->maxHeight = maxHeight;
+    mHeader->writerPid = getpid();
+    __sync_synchronize();
+    // Last, so that readers never see a half made header.
+    mHeader->magic = SharedFrameHeader::MAGIC;
+
+    mNumSlots = numSlots;
+    mNext = 0;
+    mSequence = 0;
+    mMissing.assign(numSlots, std::vector<Rect>());
+    mUnpublished.clear();
+    mPublishedWidth = mPublishedHeight = 0;
+    return true;
+}
+
+void SharedFrameExport::close() {
+    if (!mBase) {
+        return;
+    }
+    mHeader->closed = 1;
+    __sync_synchronize();
+#if BERKELIUM_PLATFORM == PLATFORM_LINUX
+    syscall(SYS_futex, &mHeader->published, FUTEX_WAKE, INT_MAX,
+            NULL, NULL, 0);
+#endif
+    munmap(mBase, mSize);
+    // Readers keep their mapping.
+    shm_unlink(mName.c_str());
+    mBase = NULL;
+    mHeader = NULL;
+    mSize = 0;
+}
+
+
+SharedFrameSlot *SharedFrameExport::slotInfo(int slot) {
+    return reinterpret_cast<SharedFrameSlot*>(
+        mBase + sizeof(SharedFrameHeader)) + slot;
+}
+
+unsigned char *SharedFrameExport::slotPixels(int slot) {
+    return mBase + mHeader->pixelOffset + (size_t)slot * mHeader->slotBytes;
+}
+
+void SharedFrameExport::invalidate(size_t numRects, const Rect *rects) {
+    if (!mBase) {
+        return;
+    }
+    for (int i = 0; i < mNumSlots; ++i) {
+        addRects(&mMissing[i], numRects, rects);
+    }
+    addRects(&mUnpublished, numRects, rects);
+}
+
+void SharedFrameExport::publish(const FrameBuffer &frame) {
+    if (!mBase || !frame.getBuffer() ||
+        frame.getWidth() > mHeader->maxWidth ||
+        frame.getHeight() > mHeader->maxHeight) {
+        return;
+    }
+    int slot = mNext;
+    mNext = (mNext + 1) % mNumSlots;
+    SharedFrameSlot *info = slotInfo(slot);
+
+    info->lock++;
+    __sync_synchronize();
+
+    int width = frame.getWidth();
+    int height = frame.getHeight();
+    Rect bounds;
+    bounds.mLeft = bounds.mTop = 0;
+    bounds.mWidth = width;
+    bounds.mHeight = height;
+    std::vector<Rect> &missing = mMissing[slot];
+    if (info->width != width || info->height != height) {
+        missing.assign(1, bounds);
+    }
+    unsigned char *pixels = slotPixels(slot);
+    size_t stride = (size_t)width * 4;
+    for (size_t i = 0; i < missing.size(); ++i) {
+        Rect r = missing[i].intersect(bounds);
+        for (int y = r.top(); y < r.bottom(); ++y) {
+            memcpy(pixels + y * stride + r.left() * 4,
+                   frame.getBuffer() + y * frame.getStride() + r.left() * 4,
+                   r.width() * 4);
+        }
+    }
+    missing.clear();
+
+    info->sequence = ++mSequence;
+    info->width = width;
+    info->height = height;
+    if (width != mPublishedWidth || height != mPublishedHeight) {
+        mUnpublished.assign(1, bounds);
+        mPublishedWidth = width;
+        mPublishedHeight = height;
+    }
+    info->numDirty = mUnpublished.size();
+    std::copy(mUnpublished.begin(), mUnpublished.end(), info->dirty);
+    mUnpublished.clear();
+
+    __sync_synchronize();
+    info->lock++;
+
+    mHeader->latestSlot = slot;
+    __sync_synchronize();
+    mHeader->published = mSequence;
+#if BERKELIUM_PLATFORM == PLATFORM_LINUX
+    syscall(SYS_futex, &mHeader->published, FUTEX_WAKE, INT_MAX,
+            NULL, NULL, 0);
+#endif
+}
+
+#else
+
+// No POSIX shared memory; mBase stays NULL, so nothing is ever written.
+bool SharedFrameExport::open(const std::string &name, int maxWidth,
+                             int maxHeight, int numSlots) {
+    return false;
+}
+
+void SharedFrameExport::close() {
+}
+
+void SharedFrameExport::invalidate(size_t numRects, const Rect *rects) {
+}
+
+void SharedFrameExport::publish(const FrameBuffer &frame) {
+}
+
+#endif
+
+}
@@ -0,0 +1,96 @@
+/*  Berkelium Implementation
+ *  SharedFrameExport.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+
+#ifndef _BERKELIUM_SHAREDFRAMEEXPORT_HPP_
+#define _BERKELIUM_SHAREDFRAMEEXPORT_HPP_
+
+#include "berkelium/Rect.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Berkelium {
+
+class FrameBuffer;
+struct SharedFrameHeader;
+struct SharedFrameSlot;
+
+/** Writer side of Window::startSharedFrameExport, see SharedFrame.hpp for
+ *  the layout. Like FrameMailboxImpl, each slot only gets the areas it
+ *  missed since it was last written. UI thread only.
+ */
+class SharedFrameExport {
+public:
+    SharedFrameExport();
+    /** Marks the segment closed and unlinks it. */
+    ~SharedFrameExport();
+
+    /** Creates and maps the named segment. A segment of that name is
+     *  only replaced if its writer closed it or has died.
+     * \returns false if that fails, the name is in use, or on Windows.
+     */
+    bool open(const std::string &name, int maxWidth, int maxHeight,
+              int numSlots);
+
+    /** Marks areas of the frame as changed. */
+    void invalidate(size_t numRects, const Rect *rects);
+
+    /** Copies what changed into the next slot and wakes up the readers.
+     *  Frames larger than the segment was made for are skipped.
+     */
+    void publish(const FrameBuffer &frame);
+
+private:
+    void close();
+    SharedFrameSlot *slotInfo(int slot);
+    unsigned char *slotPixels(int slot);
+
+    std::string mName;
+    unsigned char *mBase;
+    size_t mSize;
+    SharedFrameHeader *mHeader;
+    int mNumSlots;
+    int mNext;
+    int mSequence;
+    // Areas each slot is missing, like FrameMailboxImpl.
+    std::vector<std::vector<Rect> > mMissing;
+    // Changes since the last published frame.
+    std::vector<Rect> mUnpublished;
+    int mPublishedWidth;
+    int mPublishedHeight;
+};
+
+}
+
+#endif
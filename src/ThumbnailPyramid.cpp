@@ -0,0 +1,187 @@
+/*  Berkelium Implementation
+ *  ThumbnailPyramid.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "ThumbnailPyramid.hpp"
+#include "RectUtil.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BERKELIUM_THUMBNAIL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace Berkelium {
+
+namespace {
+
+inline unsigned char average(unsigned char a, unsigned char b) {
+    return (unsigned char)((a + b + 1) >> 1);
+}
+
+// Area of the next level down covered by rect.
+inline Rect halfRect(const Rect &rect) {
+    Rect ret;
+    ret.mLeft = rect.left() / 2;
+    ret.mTop = rect.top() / 2;
+    ret.mWidth = (rect.right() + 1) / 2 - ret.mLeft;
+    ret.mHeight = (rect.bottom() + 1) / 2 - ret.mTop;
+    return ret;
+}
+
+}
+
+ThumbnailPyramid::ThumbnailPyramid(int levels) {
+    mLevels = 0;
+    setLevels(levels);
+}
+
+void ThumbnailPyramid::setLevels(int levels) {
+    if (levels < 1) levels = 1;
+    if (levels > MAX_LEVEL) levels = MAX_LEVEL;
+    // Levels that were dropped start over when they come back.
+    for (int i = levels; i < mLevels; ++i) {
+        mImages[i].resize(0, 0);
+        mDirty[i].clear();
+    }
+    mLevels = levels;
+}
+
+const FrameBufferImpl *ThumbnailPyramid::getLevel(int level) const {
+    if (level < 1 || level > mLevels) {
+        return NULL;
+    }
+    return &mImages[level - 1];
+}
+
+const std::vector<Rect> &ThumbnailPyramid::getDirty(int level) const {
+    return mDirty[level - 1];
+}
+
+void ThumbnailPyramid::update(const FrameBuffer &frame,
+                              size_t numDirty, const Rect *dirty) {
+    const FrameBuffer *src = &frame;
+    for (int i = 0; i < mLevels; ++i) {
+        FrameBufferImpl &dest = mImages[i];
+        std::vector<Rect> &destDirty = mDirty[i];
+        destDirty.clear();
+        if (dest.resize((src->getWidth() + 1) / 2,
+                        (src->getHeight() + 1) / 2)) {
+            destDirty.push_back(dest.getBounds());
+        } else {
+            for (size_t j = 0; j < numDirty; ++j) {
+                Rect r = halfRect(dirty[j]).intersect(dest.getBounds());
+                if (!isEmptyRect(r)) {
+                    destDirty.push_back(r);
+                }
+            }
+            if (!destDirty.empty()) {
+                // Halving makes neighbouring rects overlap. Coalescing only
+                // merges the ones that contain or touch each other, so cut
+                // what is left apart to not filter shared pixels twice.
+                destDirty.resize(coalesceRects(&destDirty[0],
+                                               destDirty.size(), 0, 0));
+                makeDisjoint(&destDirty);
+            }
+        }
+        for (size_t j = 0; j < destDirty.size(); ++j) {
+            downscale(*src, &dest, destDirty[j]);
+        }
+        src = &dest;
+        numDirty = destDirty.size();
+        dirty = numDirty ? &destDirty[0] : NULL;
+    }
+}
+
+void ThumbnailPyramid::makeDisjoint(std::vector<Rect> *rects) {
+    mDisjoint.clear();
+    for (size_t i = 0; i < rects->size(); ++i) {
+        mPieces.clear();
+        mPieces.push_back((*rects)[i]);
+        // Whatever is already in mDisjoint covers the earlier rects.
+        for (size_t j = 0; j < mDisjoint.size() && !mPieces.empty(); ++j) {
+            mScratch.clear();
+            for (size_t k = 0; k < mPieces.size(); ++k) {
+                subtractRect(mPieces[k], mDisjoint[j], &mScratch);
+            }
+            mPieces.swap(mScratch);
+        }
+        mDisjoint.insert(mDisjoint.end(), mPieces.begin(), mPieces.end());
+    }
+    rects->assign(mDisjoint.begin(), mDisjoint.end());
+}
+
+void ThumbnailPyramid::downscale(const FrameBuffer &src, FrameBufferImpl *dest,
+                                 const Rect &destRect) {
+    int srcWidth = src.getWidth();
+    int srcHeight = src.getHeight();
+    if (!srcWidth || !srcHeight) {
+        return;
+    }
+    for (int y = destRect.top(); y < destRect.bottom(); ++y) {
+        int y0 = y * 2;
+        int y1 = y0 + 1 < srcHeight ? y0 + 1 : srcHeight - 1;
+        const unsigned char *row0 = src.getBuffer() + y0 * src.getStride();
+        const unsigned char *row1 = src.getBuffer() + y1 * src.getStride();
+        unsigned char *out = dest->getMutableBuffer() + y * dest->getStride();
+        int x = destRect.left();
+#ifdef BERKELIUM_THUMBNAIL_SSE2
+        // Four output pixels from eight input pixels of each row.
+        for (; x + 4 <= destRect.right() && x * 2 + 8 <= srcWidth; x += 4) {
+            const unsigned char *a = row0 + x * 8;
+            const unsigned char *b = row1 + x * 8;
+            __m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)a),
+                                      _mm_loadu_si128((const __m128i*)b));
+            __m128i v1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(a + 16)),
+                                      _mm_loadu_si128((const __m128i*)(b + 16)));
+            v0 = _mm_avg_epu8(v0, _mm_srli_epi64(v0, 32));
+            v1 = _mm_avg_epu8(v1, _mm_srli_epi64(v1, 32));
+            v0 = _mm_shuffle_epi32(v0, _MM_SHUFFLE(3,1,2,0));
+            v1 = _mm_shuffle_epi32(v1, _MM_SHUFFLE(3,1,2,0));
+            _mm_storeu_si128((__m128i*)(out + x * 4),
+                             _mm_unpacklo_epi64(v0, v1));
+        }
+#endif
+        for (; x < destRect.right(); ++x) {
+            int x0 = x * 2;
+            int x1 = x0 + 1 < srcWidth ? x0 + 1 : srcWidth - 1;
+            const unsigned char *a0 = row0 + x0 * 4, *a1 = row0 + x1 * 4;
+            const unsigned char *b0 = row1 + x0 * 4, *b1 = row1 + x1 * 4;
+            unsigned char *d = out + x * 4;
+            for (int c = 0; c < 4; ++c) {
+                d[c] = average(average(a0[c], b0[c]), average(a1[c], b1[c]));
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+/*  Berkelium Implementation
+ *  ThumbnailPyramid.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_THUMBNAILPYRAMID_HPP_
+#define _BERKELIUM_THUMBNAILPYRAMID_HPP_
+
+#include "FrameBufferImpl.hpp"
+
+#include <vector>
+
+namespace Berkelium {
+
+/** Half, quarter and eighth size copies of a frame, each a 2x2 box filter
+ *  of the level above. Only the parts under the frame's dirty rects are
+ *  recomputed.
+ */
+class ThumbnailPyramid {
+public:
+    enum { MAX_LEVEL = 3 };
+
+    explicit ThumbnailPyramid(int levels);
+
+    /** Number of levels kept up to date, 1 to MAX_LEVEL. */
+    int levels() const { return mLevels; }
+    void setLevels(int levels);
+
+    /** Level 1 is half size, level 2 quarter size, and so on. */
+    const FrameBufferImpl *getLevel(int level) const;
+
+    /** Rects of level changed by the last update, in its coordinates. */
+    const std::vector<Rect> &getDirty(int level) const;
+
+    /** Brings every level up to date with frame.
+     *  \param dirty  Changed areas of frame since the last update.
+     */
+    void update(const FrameBuffer &frame, size_t numDirty, const Rect *dirty);
+
+private:
+    // Cuts rects into pieces that don't overlap, covering the same pixels.
+    void makeDisjoint(std::vector<Rect> *rects);
+    static void downscale(const FrameBuffer &src, FrameBufferImpl *dest,
+                          const Rect &destRect);
+
+    int mLevels;
+    FrameBufferImpl mImages[MAX_LEVEL];
+    std::vector<Rect> mDirty[MAX_LEVEL];
+    // Scratch space of makeDisjoint, kept for its capacity.
+    std::vector<Rect> mDisjoint;
+    std::vector<Rect> mPieces;
+    std::vector<Rect> mScratch;
+};
+
+}
+
+#endif
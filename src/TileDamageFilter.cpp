@@ -0,0 +1,168 @@
+/*  Berkelium Implementation
+ *  TileDamageFilter.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "TileDamageFilter.hpp"
+
+#include <string.h>
+
+namespace Berkelium {
+
+namespace {
+
+const uint64 kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64 kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+inline uint64 mix(uint64 h, uint64 v) {
+    h ^= v * kPrime2;
+    h = (h << 31) | (h >> 33);
+    return h * kPrime1;
+}
+
+}
+
+TileDamageFilter::TileDamageFilter(int tileSize)
+    : mTileSize(tileSize > 0 ? tileSize : 64), mColumns(0), mRows(0) {
+}
+
+void TileDamageFilter::reset() {
+    mTiles.assign(mTiles.size(), Tile());
+}
+
+void TileDamageFilter::invalidate(const gfx::Rect &rect) {
+    gfx::Rect r = rect.Intersect(
+        gfx::Rect(0, 0, mViewSize.width(), mViewSize.height()));
+    if (r.IsEmpty()) {
+        return;
+    }
+    for (int ty = r.y() / mTileSize; ty <= (r.bottom() - 1) / mTileSize; ++ty) {
+        for (int tx = r.x() / mTileSize; tx <= (r.right() - 1) / mTileSize; ++tx) {
+            mTiles[ty * mColumns + tx] = Tile();
+        }
+    }
+}
+
+uint64 TileDamageFilter::hashArea(const unsigned char *bitmap,
+                                  const gfx::Rect &bitmapRect,
+                                  const gfx::Rect &area) {
+    size_t stride = bitmapRect.width() * 4;
+    size_t rowBytes = area.width() * 4;
+    uint64 h = kPrime1 ^ rowBytes;
+    for (int y = area.y(); y < area.bottom(); ++y) {
+        const unsigned char *row = bitmap +
+            (y - bitmapRect.y()) * stride + (area.x() - bitmapRect.x()) * 4;
+        size_t i = 0;
+        for (; i + 8 <= rowBytes; i += 8) {
+            uint64 v;
+            memcpy(&v, row + i, 8);
+            h = mix(h, v);
+        }
+        if (i < rowBytes) {
+            uint32 v;
+            memcpy(&v, row + i, 4);
+            h = mix(h, v);
+        }
+    }
+    h ^= h >> 29;
+    h *= kPrime2;
+    return h ^ (h >> 32);
+}
+
+void TileDamageFilter::addSpan(std::vector<gfx::Rect> *changed, size_t first,
+                               const gfx::Rect &span) {
+    // Continue a rect from the tile row above if it has the same columns.
+    for (size_t i = first; i < changed->size(); ++i) {
+        gfx::Rect &r = (*changed)[i];
+        if (r.x() == span.x() && r.width() == span.width() &&
+            r.bottom() == span.y()) {
+            r.set_height(r.height() + span.height());
+            return;
+        }
+    }
+    changed->push_back(span);
+}
+
+bool TileDamageFilter::filter(const unsigned char *bitmap,
+                              const gfx::Rect &bitmapRect,
+                              const std::vector<gfx::Rect> &copyRects,
+                              const gfx::Size &viewSize,
+                              int dx, int dy, const gfx::Rect &scrollRect,
+                              std::vector<gfx::Rect> *changed) {
+    if (viewSize != mViewSize) {
+        mViewSize = viewSize;
+        mColumns = (viewSize.width() + mTileSize - 1) / mTileSize;
+        mRows = (viewSize.height() + mTileSize - 1) / mTileSize;
+        mTiles.assign(mColumns * mRows, Tile());
+    }
+    if (dx || dy) {
+        invalidate(scrollRect);
+    }
+    changed->clear();
+    gfx::Rect bounds = bitmapRect.Intersect(
+        gfx::Rect(0, 0, viewSize.width(), viewSize.height()));
+    for (size_t i = 0; i < copyRects.size(); ++i) {
+        gfx::Rect r = copyRects[i].Intersect(bounds);
+        if (r.IsEmpty()) {
+            continue;
+        }
+        size_t first = changed->size();
+        for (int ty = r.y() / mTileSize; ty <= (r.bottom() - 1) / mTileSize; ++ty) {
+            gfx::Rect span;
+            for (int tx = r.x() / mTileSize; tx <= (r.right() - 1) / mTileSize; ++tx) {
+                gfx::Rect area = r.Intersect(gfx::Rect(
+                    tx * mTileSize, ty * mTileSize, mTileSize, mTileSize));
+                uint64 hash = hashArea(bitmap, bitmapRect, area);
+                Tile &tile = mTiles[ty * mColumns + tx];
+                bool same = tile.hash == hash && tile.area == area;
+                tile.hash = hash;
+                tile.area = area;
+                if (same) {
+                    if (!span.IsEmpty()) {
+                        addSpan(changed, first, span);
+                        span = gfx::Rect();
+                    }
+                } else if (span.IsEmpty()) {
+                    span = area;
+                } else {
+                    span.set_width(area.right() - span.x());
+                }
+            }
+            if (!span.IsEmpty()) {
+                addSpan(changed, first, span);
+            }
+        }
+    }
+    return !changed->empty() || dx || dy;
+}
+
+}
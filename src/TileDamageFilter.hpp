@@ -0,0 +1,103 @@
+/*  Berkelium Implementation
+ *  TileDamageFilter.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_TILEDAMAGEFILTER_HPP_
+#define _BERKELIUM_TILEDAMAGEFILTER_HPP_
+
+#include "base/basictypes.h"
+#include "gfx/rect.h"
+#include "gfx/size.h"
+
+#include <vector>
+
+namespace Berkelium {
+
+/** Drops the parts of a paint whose pixels didn't change.
+ *
+ *  The view is split into square tiles. For every tile a paint touches, the
+ *  painted part of the tile is hashed and compared with what was painted
+ *  there last time; only tiles that differ are kept. A tile only counts as
+ *  unchanged when the same area was painted with the same hash, so partial
+ *  paints just fall back to reporting damage.
+ *
+ *  Whatever changes the view without going through filter() has to call
+ *  reset() or invalidate(), or later identical-looking paints get dropped.
+ */
+class TileDamageFilter {
+public:
+    explicit TileDamageFilter(int tileSize);
+
+    int tileSize() const { return mTileSize; }
+
+    /** Forgets every tile, so the next paint is reported in full. */
+    void reset();
+
+    /** Forgets the tiles touching rect. */
+    void invalidate(const gfx::Rect &rect);
+
+    /** Computes the parts of copyRects that changed.
+     *  \param bitmap  Paint bitmap covering bitmapRect, 4 bytes per pixel.
+     *  \param changed  Receives the changed areas, merged back into rects
+     *      where whole runs of tiles changed.
+     *  \returns whether anything is left to deliver, counting scrolls.
+     */
+    bool filter(const unsigned char *bitmap, const gfx::Rect &bitmapRect,
+                const std::vector<gfx::Rect> &copyRects,
+                const gfx::Size &viewSize,
+                int dx, int dy, const gfx::Rect &scrollRect,
+                std::vector<gfx::Rect> *changed);
+
+private:
+    struct Tile {
+        uint64 hash;
+        // Area covered by hash; empty if unknown.
+        gfx::Rect area;
+        Tile() : hash(0) {}
+    };
+
+    static uint64 hashArea(const unsigned char *bitmap,
+                           const gfx::Rect &bitmapRect,
+                           const gfx::Rect &area);
+    static void addSpan(std::vector<gfx::Rect> *changed, size_t first,
+                        const gfx::Rect &span);
+
+    int mTileSize;
+    gfx::Size mViewSize;
+    int mColumns;
+    int mRows;
+    std::vector<Tile> mTiles;
+};
+
+}
+
+#endif
@@ -0,0 +1,192 @@
+/*  Berkelium Implementation
+ *  WidgetCompositor.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/Widget.hpp"
+#include "WidgetCompositor.hpp"
+#include "RectUtil.hpp"
+
+#include <string.h>
+
+namespace Berkelium {
+
+namespace {
+const int kBytesPerPixel = 4;
+
+bool sameRect(const Rect &a, const Rect &b) {
+    return a.left() == b.left() && a.top() == b.top() &&
+        a.width() == b.width() && a.height() == b.height();
+}
+}
+
+WidgetCompositor::WidgetCompositor() {
+    mWidth = mHeight = 0;
+}
+
+WidgetCompositor::~WidgetCompositor() {
+    for (LayerMap::iterator it = mLayers.begin(); it != mLayers.end(); ++it) {
+        delete it->second;
+    }
+}
+
+Rect WidgetCompositor::getBounds() const {
+    Rect ret;
+    ret.mLeft = ret.mTop = 0;
+    ret.mWidth = mWidth;
+    ret.mHeight = mHeight;
+    return ret;
+}
+
+Rect WidgetCompositor::layerRect(const Widget *wid, const FrameBuffer &image) {
+    Rect ret = wid->getRect();
+    // The widget reports the size it asked for; what counts is what it
+    // actually painted.
+    ret.mWidth = image.getWidth();
+    ret.mHeight = image.getHeight();
+    return ret;
+}
+
+void WidgetCompositor::invalidate(const Rect &rect) {
+    if (!isEmptyRect(rect)) {
+        mPending.push_back(rect);
+    }
+}
+
+void WidgetCompositor::invalidate(size_t numRects, const Rect *rects) {
+    for (size_t i = 0; i < numRects; ++i) {
+        invalidate(rects[i]);
+    }
+}
+
+void WidgetCompositor::applyWidgetPaint(Widget *wid, const PaintFrame *frame) {
+    Layer *&layer = mLayers[wid];
+    bool created = !layer;
+    if (created) {
+        layer = new Layer;
+    }
+    mScratch.clear();
+    layer->image.applyPaint(frame, &mScratch);
+    if (created) {
+        layer->rect = layerRect(wid, layer->image);
+    }
+    // A resized layer is handled like a move by compose.
+    Rect pos = wid->getRect();
+    for (size_t i = 0; i < mScratch.size(); ++i) {
+        invalidate(mScratch[i].translate(pos.left(), pos.top()));
+    }
+}
+
+void WidgetCompositor::removeWidget(Widget *wid) {
+    LayerMap::iterator it = mLayers.find(wid);
+    if (it == mLayers.end()) {
+        return;
+    }
+    invalidate(it->second->rect);
+    delete it->second;
+    mLayers.erase(it);
+}
+
+void WidgetCompositor::copyRect(const FrameBuffer &src, int srcX, int srcY,
+                                const Rect &rect) {
+    const size_t stride = (size_t)mWidth * kBytesPerPixel;
+    const size_t rowBytes = (size_t)rect.width() * kBytesPerPixel;
+    unsigned char *out = &mImage[0] + rect.top() * stride
+        + rect.left() * kBytesPerPixel;
+    const unsigned char *in = src.getBuffer()
+        + (rect.top() - srcY) * src.getStride()
+        + (rect.left() - srcX) * kBytesPerPixel;
+    for (int y = 0; y < rect.height(); ++y) {
+        memcpy(out, in, rowBytes);
+        out += stride;
+        in += src.getStride();
+    }
+}
+
+bool WidgetCompositor::compose(const FrameBuffer &page,
+                               Window::BackToFrontIter begin,
+                               Window::BackToFrontIter end) {
+    if (page.getWidth() != mWidth || page.getHeight() != mHeight) {
+        mWidth = page.getWidth();
+        mHeight = page.getHeight();
+        mImage.resize((size_t)mWidth * mHeight * kBytesPerPixel);
+        mPending.clear();
+        invalidate(getBounds());
+    }
+    for (Window::BackToFrontIter it = begin; it != end; ++it) {
+        LayerMap::iterator layer = mLayers.find(*it);
+        if (layer == mLayers.end()) {
+            continue;
+        }
+        Rect now = layerRect(*it, layer->second->image);
+        if (!sameRect(now, layer->second->rect)) {
+            invalidate(layer->second->rect);
+            invalidate(now);
+            layer->second->rect = now;
+        }
+    }
+
+    mDamage.clear();
+    if (mPending.empty()) {
+        return false;
+    }
+    mDamage.swap(mPending);
+    mDamage.resize(coalesceRects(&mDamage[0], mDamage.size(), 0, 0));
+    Rect bounds = getBounds();
+    size_t numDamage = 0;
+    for (size_t i = 0; i < mDamage.size(); ++i) {
+        Rect r = mDamage[i].intersect(bounds);
+        if (!isEmptyRect(r)) {
+            mDamage[numDamage++] = r;
+        }
+    }
+    mDamage.resize(numDamage);
+
+    for (size_t i = 0; i < mDamage.size(); ++i) {
+        const Rect &d = mDamage[i];
+        copyRect(page, 0, 0, d);
+        for (Window::BackToFrontIter it = begin; it != end; ++it) {
+            LayerMap::iterator layer = mLayers.find(*it);
+            if (layer == mLayers.end()) {
+                continue;
+            }
+            const Rect &lr = layer->second->rect;
+            Rect r = d.intersect(lr);
+            if (!isEmptyRect(r)) {
+                copyRect(layer->second->image, lr.left(), lr.top(), r);
+            }
+        }
+    }
+    return !mDamage.empty();
+}
+
+}
@@ -0,0 +1,105 @@
+/*  Berkelium Implementation
+ *  WidgetCompositor.hpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _BERKELIUM_WIDGETCOMPOSITOR_HPP_
+#define _BERKELIUM_WIDGETCOMPOSITOR_HPP_
+
+#include "berkelium/Window.hpp"
+#include "FrameBufferImpl.hpp"
+
+#include <map>
+#include <vector>
+
+namespace Berkelium {
+
+/** The page with its popup widgets drawn on top, for
+ *  Window::setWidgetCompositing. Each widget paints into a layer of its
+ *  own; compose() redraws only what changed since the last call. The
+ *  result is tightly packed BGRA, so it can go straight to onPaint.
+ */
+class WidgetCompositor {
+public:
+    WidgetCompositor();
+    ~WidgetCompositor();
+
+    /** Marks areas of the page as changed. */
+    void invalidate(size_t numRects, const Rect *rects);
+
+    /** Updates the widget's layer and marks what it changed. */
+    void applyWidgetPaint(Widget *wid, const PaintFrame *frame);
+
+    /** Drops the widget's layer, uncovering the page beneath it. */
+    void removeWidget(Widget *wid);
+
+    /** Redraws the changed areas: page first, then the widget layers in
+     *  the given order. Widgets that moved since the last call are
+     *  noticed here.
+     *  \returns false if nothing changed
+     */
+    bool compose(const FrameBuffer &page,
+                 Window::BackToFrontIter begin, Window::BackToFrontIter end);
+
+    const unsigned char *getBuffer() const {
+        return mImage.empty() ? NULL : &mImage[0];
+    }
+    Rect getBounds() const;
+    /** Areas redrawn by the last compose. */
+    const std::vector<Rect> &getDamage() const {
+        return mDamage;
+    }
+
+private:
+    struct Layer {
+        FrameBufferImpl image;
+        // Where image was last composed.
+        Rect rect;
+    };
+    typedef std::map<Widget*, Layer*> LayerMap;
+
+    void invalidate(const Rect &rect);
+    void copyRect(const FrameBuffer &src, int srcX, int srcY,
+                  const Rect &rect);
+    static Rect layerRect(const Widget *wid, const FrameBuffer &image);
+
+    LayerMap mLayers;
+    std::vector<unsigned char> mImage;
+    int mWidth;
+    int mHeight;
+    std::vector<Rect> mPending;
+    std::vector<Rect> mDamage;
+    std::vector<Rect> mScratch;
+};
+
+}
+
+#endif
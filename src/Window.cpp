@@ -31,7 +31,9 @@
  */
 
 #include "berkelium/Platform.hpp"
+#include "berkelium/WindowDelegate.hpp"
 #include "WindowImpl.hpp"
+#include "PaintFrameImpl.hpp"
 #include "Root.hpp"
 #include "ContextImpl.hpp"
 
@@ -74,5 +76,18 @@ void Window::destroy() {
     delete this;
 }
 
+void WindowDelegate::onPaintFrame(Window *win, PaintFrame *frame) {
+    static_cast<WindowImpl*>(win)->callPaintDelegate(
+        this, NULL, frame,
+        static_cast<PaintFrameImpl*>(frame)->getDeliveryFormat(), false);
+}
+
+void WindowDelegate::onWidgetPaintFrame(Window *win, Widget *wid,
+                                        PaintFrame *frame) {
+    static_cast<WindowImpl*>(win)->callPaintDelegate(
+        this, wid, frame,
+        static_cast<PaintFrameImpl*>(frame)->getDeliveryFormat(), false);
+}
+
 }
 
@@ -35,11 +35,26 @@
 #include "RenderWidget.hpp"
 #include "WindowImpl.hpp"
 #include "MemoryRenderViewHost.hpp"
+#include "FrameBufferImpl.hpp"
+#include "PaintFrameImpl.hpp"
+#include "RectUtil.hpp"
+#include "ThumbnailPyramid.hpp"
+#include "WidgetCompositor.hpp"
+#include "FrameRecorder.hpp"
+#include "FrameMailboxImpl.hpp"
+#include "SharedFrameExport.hpp"
+#include "PaintDispatcher.hpp"
 #include "Root.hpp"
+#include "FrameBufferBudget.hpp"
+#include "InputRecorder.hpp"
+#include "InputReplayer.hpp"
+#include "berkelium/Berkelium.hpp"
 #include "berkelium/WindowDelegate.hpp"
 #include "berkelium/Cursor.hpp"
 #include "berkelium/Context.hpp"
 #include "berkelium/Rect.hpp"
+#include "berkelium/PaintFrame.hpp"
+#include "berkelium/Capture.hpp"
 #include "berkelium/ScriptVariant.hpp"
 #include "ScriptUtilImpl.hpp"
 
@@ -80,7 +95,32 @@ void WindowImpl::init(SiteInstance*site, int routing_id) {
     mId = routing_id;
     received_page_title_=false;
     is_crashed_=false;
+    is_loading_=false;
     mIsReentrant = false;
+    mDeferredPaintAck = false;
+    mFrameBuffer = NULL;
+    mFrameBufferEnabled = false;
+    mFrameComplete = false;
+    mThumbnails = NULL;
+    mCompositor = NULL;
+    mMailbox = NULL;
+    mSharedExport = NULL;
+    mVisible = true;
+    mCoalescing.perRectCost = 0;
+    mCoalescing.maxRects = 0;
+    mHasPaintInterest = false;
+    mInputCoalescing = true;
+    // Off: pages may depend on key events for every character.
+    mTextInsertThreshold = 0;
+    mInputRecorder = NULL;
+    mInputReplayer = NULL;
+    mReplayIndex = -1;
+    memset(&mLastReplayStats, 0, sizeof(mLastReplayStats));
+    memset(&mInputStats, 0, sizeof(mInputStats));
+    mMaxFrameRate = 0;
+    mHeldFrame = NULL;
+    mRepaintWhenReady = false;
+    mPaintFormat = PIXEL_FORMAT_BGRA;
     mUniqueId = std::wstring();
     for (int i = 0; i < 32; i++) {
         if (i == 8 || i == 12 || i == 16 || i == 20) {
@@ -121,10 +161,25 @@ WindowImpl::WindowImpl(const Context*otherContext, int routing_id):
     CreateRenderViewForRenderManager(host(), true);
 }
 WindowImpl::~WindowImpl() {
+    // Widgets going away with the view shouldn't paint anymore.
+    delete mCompositor;
+    mCompositor = NULL;
+    dropHeldPaint();
+    deliverCaptures(NULL, false);
+    stopRecording();
+    stopInputRecording();
+    stopInputReplay();
+    if (mPaintQueue) {
+        mPaintQueue->cancel();
+    }
     RenderViewHost* render_view_host = mRenderViewHost;
     mRenderViewHost = NULL;
     render_view_host->Shutdown();
     delete mController;
+    delete mThumbnails;
+    delete mMailbox;
+    delete mSharedExport;
+    freeFrameBuffer();
 }
 
 RenderProcessHost *WindowImpl::process() const {
@@ -152,6 +207,7 @@ void WindowImpl::SetIsCrashed(bool state) {
 }
 
 void WindowImpl::SetIsLoading(bool is_loading) {
+    is_loading_ = is_loading;
     host()->SetIsLoading(is_loading);
 }
 int WindowImpl::GetBrowserWindowID() const {
@@ -312,6 +368,372 @@ void WindowImpl::setTransparent(bool istrans) {
     }
 }
 
+void WindowImpl::setDeferredPaintAck(bool deferred) {
+    mDeferredPaintAck = deferred;
+}
+
+void WindowImpl::setFrameBufferEnabled(bool enabled) {
+    mFrameBufferEnabled = enabled;
+    updateFrameBuffer();
+}
+
+void WindowImpl::updateFrameBuffer() {
+    // Captures, thumbnails, the compositor, recordings, the mailbox and
+    // the shared memory export borrow the frame buffer.
+    bool needed = mFrameBufferEnabled || !mCaptures.empty() || mThumbnails ||
+        mCompositor || mRecorder || mMailbox || mSharedExport;
+    if (needed == (mFrameBuffer != NULL)) {
+        return;
+    }
+    mFrameComplete = false;
+    if (needed) {
+        mFrameBuffer = new FrameBufferImpl;
+        mFrameDirty.reserve(32);
+        // Fill in the parts of the page that won't otherwise be repainted.
+        if (host()) {
+            static_cast<MemoryRenderViewHost*>(host())->Memory_Repaint();
+        }
+    } else {
+        freeFrameBuffer();
+    }
+}
+
+void WindowImpl::freeFrameBuffer() {
+    Root::getSingleton().getFrameBufferBudget()->remove(this);
+    delete mFrameBuffer;
+    mFrameBuffer = NULL;
+}
+
+bool WindowImpl::evictFrameBuffer() {
+    // Whatever is on screen has to stay.
+    if (mVisible || !mFrameBuffer) {
+        return false;
+    }
+    freeFrameBuffer();
+    mFrameComplete = false;
+    return true;
+}
+
+const FrameBuffer* WindowImpl::getFrame() const {
+    return mFrameBufferEnabled ? mFrameBuffer : NULL;
+}
+
+void WindowImpl::setPaintCoalescing(const PaintCoalescing &policy) {
+    mCoalescing = policy;
+    if (mCoalescing.perRectCost < 0) {
+        mCoalescing.perRectCost = 0;
+    }
+    if (mCoalescing.maxRects < 0) {
+        mCoalescing.maxRects = 0;
+    }
+}
+
+void WindowImpl::setPaintFormat(PixelFormat format) {
+    mPaintFormat = format;
+    // With threaded paint the buffer belongs to the paint thread.
+    if (format == PIXEL_FORMAT_BGRA && !mPaintQueue) {
+        std::vector<unsigned char>().swap(mConvertBuffer);
+    }
+}
+
+void WindowImpl::setDamageFilter(bool enabled, int tileSize) {
+    if (host()) {
+        static_cast<MemoryRenderViewHost*>(host())->Memory_SetDamageFilter(
+            enabled, tileSize > 0 ? tileSize : 64);
+    }
+}
+
+void WindowImpl::setThreadedPaint(bool threaded) {
+    if (threaded == (mPaintQueue != NULL)) {
+        return;
+    }
+    if (threaded) {
+        mPaintQueue = Root::getSingleton().getPaintDispatcher()->createQueue(this);
+    } else {
+        bool dropped = mPaintQueue->cancel();
+        mPaintQueue = NULL;
+        // Make up for the paints the delegate never saw.
+        if (dropped && host()) {
+            static_cast<MemoryRenderViewHost*>(host())->Memory_Repaint();
+        }
+    }
+}
+
+void WindowImpl::setMaxFrameRate(int fps) {
+    mMaxFrameRate = fps > 0 ? fps : 0;
+    if (!mHeldFrame) {
+        return;
+    }
+    if (!mMaxFrameRate) {
+        flushHeldPaint();
+        return;
+    }
+    // The held paint's timer still runs on the old interval.
+    base::TimeDelta interval = base::TimeDelta::FromMicroseconds(
+        base::Time::kMicrosecondsPerSecond / mMaxFrameRate);
+    base::TimeDelta elapsed = base::TimeTicks::Now() - mLastPaintTime;
+    if (elapsed >= interval) {
+        flushHeldPaint();
+    } else {
+        mPaintTimer.Start(interval - elapsed, this,
+                          &WindowImpl::flushHeldPaint);
+    }
+}
+
+void WindowImpl::setThumbnailLevel(int level) {
+    if (level <= 0) {
+        delete mThumbnails;
+        mThumbnails = NULL;
+        updateFrameBuffer();
+        return;
+    }
+    if (mThumbnails) {
+        mThumbnails->setLevels(level);
+        return;
+    }
+    mThumbnails = new ThumbnailPyramid(level);
+    // A new frame buffer is empty, and fills in with the repaint it asks for.
+    updateFrameBuffer();
+}
+
+const FrameBuffer* WindowImpl::getThumbnail(int level) const {
+    return mThumbnails ? mThumbnails->getLevel(level) : NULL;
+}
+
+void WindowImpl::setPaintInterest(const Rect *rects, size_t numRects) {
+    // Anything not covered by the old region was never delivered.
+    bool grew = mHasPaintInterest && !numRects;
+    std::vector<Rect> interest;
+    for (size_t i = 0; i < numRects; ++i) {
+        if (isEmptyRect(rects[i])) {
+            continue;
+        }
+        bool covered = !mHasPaintInterest;
+        for (size_t j = 0; j < mPaintInterest.size() && !covered; ++j) {
+            Rect r = rects[i].intersect(mPaintInterest[j]);
+            covered = r.width() == rects[i].width() &&
+                r.height() == rects[i].height();
+        }
+        grew = grew || !covered;
+        interest.push_back(rects[i]);
+    }
+    mHasPaintInterest = numRects > 0;
+    mPaintInterest.swap(interest);
+    if (grew && host()) {
+        static_cast<MemoryRenderViewHost*>(host())->Memory_Repaint();
+    }
+}
+
+void WindowImpl::setWidgetCompositing(bool enabled) {
+    if (enabled == (mCompositor != NULL)) {
+        return;
+    }
+    if (!enabled) {
+        delete mCompositor;
+        mCompositor = NULL;
+        updateFrameBuffer();
+        return;
+    }
+    mCompositor = new WidgetCompositor;
+    // The first compose draws the whole page; the widgets have to paint
+    // their layers from scratch.
+    updateFrameBuffer();
+    repaintWidgets();
+}
+
+void WindowImpl::repaintWidgets() {
+    for (BackToFrontIter it = backIter(); it != backEnd(); ++it) {
+        if (*it == getWidget()) {
+            continue;
+        }
+        RenderWidgetHost *widgetHost =
+            static_cast<RenderWidget*>(*it)->GetRenderWidgetHost();
+        if (widgetHost) {
+            static_cast<MemoryRenderWidgetHost*>(widgetHost)->Memory_Repaint();
+        }
+    }
+}
+
+void WindowImpl::setVisible(bool visible) {
+    if (visible == mVisible) {
+        return;
+    }
+    mVisible = visible;
+    for (BackToFrontIter it = backIter(); it != backEnd(); ++it) {
+        RenderWidget *wid = static_cast<RenderWidget*>(*it);
+        if (visible) {
+            wid->DidBecomeSelected();
+        } else {
+            wid->WasHidden();
+        }
+    }
+    if (!visible) {
+        // Nothing more gets painted for captures still waiting.
+        if (!mCaptures.empty()) {
+            deliverCaptures(NULL, false);
+        }
+        // Now that it may be evicted, make room for the visible ones.
+        Root::getSingleton().getFrameBufferBudget()->trim();
+        return;
+    }
+    // An evicted frame buffer comes back with a repaint of its own.
+    bool hadFrameBuffer = mFrameBuffer != NULL;
+    updateFrameBuffer();
+    if (host()) {
+        // Nothing was painted while hidden, and the renderer only repaints
+        // on restore when it thinks our backing store is gone.
+        if (hadFrameBuffer || !mFrameBuffer) {
+            static_cast<MemoryRenderViewHost*>(host())->Memory_Repaint();
+        }
+        repaintWidgets();
+    }
+}
+
+bool WindowImpl::startRecording(FileString filename, RecordFormat format,
+                                int fps, int bufferFrames) {
+    if (mRecorder || fps <= 0 || bufferFrames <= 0) {
+        return false;
+    }
+    scoped_refptr<FrameRecorder> recorder(
+        new FrameRecorder(format, fps, bufferFrames));
+    if (!recorder->start(FilePath(filename.get<FilePath::StringType>()))) {
+        return false;
+    }
+    mRecorder = recorder;
+    updateFrameBuffer();
+    base::TimeDelta interval = base::TimeDelta::FromMicroseconds(
+        base::Time::kMicrosecondsPerSecond / fps);
+    mRecordTimer.Start(interval, this, &WindowImpl::sampleRecording);
+    return true;
+}
+
+void WindowImpl::sampleRecording() {
+    // Until the first full paint there is nothing worth a frame.
+    if (mFrameBuffer && mFrameComplete) {
+        mRecorder->sample(*mFrameBuffer, base::TimeTicks::Now());
+    }
+}
+
+RecordStats WindowImpl::stopRecording() {
+    RecordStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!mRecorder) {
+        return stats;
+    }
+    mRecordTimer.Stop();
+    mRecorder->stop();
+    stats = mRecorder->getStats();
+    mRecorder = NULL;
+    updateFrameBuffer();
+    return stats;
+}
+
+RecordStats WindowImpl::getRecordStats() const {
+    if (!mRecorder) {
+        RecordStats stats;
+        memset(&stats, 0, sizeof(stats));
+        return stats;
+    }
+    return mRecorder->getStats();
+}
+
+FrameMailbox *WindowImpl::getFrameMailbox() {
+    if (!mMailbox) {
+        mMailbox = new FrameMailboxImpl;
+        bool hadFrameBuffer = mFrameBuffer != NULL;
+        updateFrameBuffer();
+        // Otherwise a page that doesn't paint would never publish.
+        if (hadFrameBuffer && mFrameComplete) {
+            mMailbox->publish(*mFrameBuffer);
+        }
+    }
+    return mMailbox;
+}
+
+bool WindowImpl::startSharedFrameExport(URLString name, int maxWidth,
+                                        int maxHeight, int numSlots) {
+    stopSharedFrameExport();
+    SharedFrameExport *exporter = new SharedFrameExport;
+    if (!exporter->open(name.get<std::string>(), maxWidth, maxHeight,
+                        numSlots)) {
+        delete exporter;
+        return false;
+    }
+    mSharedExport = exporter;
+    bool hadFrameBuffer = mFrameBuffer != NULL;
+    updateFrameBuffer();
+    if (hadFrameBuffer && mFrameComplete) {
+        mSharedExport->publish(*mFrameBuffer);
+    }
+    return true;
+}
+
+void WindowImpl::stopSharedFrameExport() {
+    if (mSharedExport) {
+        delete mSharedExport;
+        mSharedExport = NULL;
+        updateFrameBuffer();
+    }
+}
+
+void WindowImpl::captureFrame(CaptureDelegate *callback) {
+    PendingCapture capture;
+    capture.callback = callback;
+    capture.requested = base::TimeTicks::Now();
+    if (!is_loading_) {
+        capture.loaded = capture.requested;
+    }
+    capture.numPaints = 0;
+    bool hadFrameBuffer = mFrameBuffer != NULL;
+    mCaptures.push_back(capture);
+    updateFrameBuffer();
+    if (!mVisible) {
+        // A hidden renderer doesn't paint, so this is all there will be.
+        deliverCaptures(callback, mFrameComplete);
+        return;
+    }
+    if (is_loading_) {
+        // DidStopLoading asks for the repaint.
+        return;
+    }
+    if (mFrameComplete) {
+        deliverCaptures(NULL, true);
+    } else if (hadFrameBuffer && host()) {
+        static_cast<MemoryRenderViewHost*>(host())->Memory_Repaint();
+    }
+}
+
+void WindowImpl::cancelCapture(CaptureDelegate *callback) {
+    deliverCaptures(callback, false);
+}
+
+void WindowImpl::deliverCaptures(CaptureDelegate *only, bool complete) {
+    // Callbacks may request new captures, so work on a copy.
+    std::vector<PendingCapture> captures;
+    for (size_t i = 0; i < mCaptures.size(); ) {
+        if (!only || mCaptures[i].callback == only) {
+            captures.push_back(mCaptures[i]);
+            mCaptures.erase(mCaptures.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+    base::TimeTicks now = base::TimeTicks::Now();
+    const FrameBuffer *frame =
+        mFrameBuffer && mFrameBuffer->getBuffer() ? mFrameBuffer : NULL;
+    for (size_t i = 0; i < captures.size(); ++i) {
+        const PendingCapture &capture = captures[i];
+        CaptureInfo info;
+        info.complete = complete;
+        info.totalTime = (now - capture.requested).InSecondsF();
+        info.loadTime = ((capture.loaded.is_null() ? now : capture.loaded) -
+                         capture.requested).InSecondsF();
+        info.numPaints = capture.numPaints;
+        capture.callback->onCapture(this, frame, info);
+    }
+    updateFrameBuffer();
+}
+
 void WindowImpl::focus() {
     FrontToBackIter iter = frontIter();
     if (iter != frontEnd()) {
@@ -335,6 +757,19 @@ void WindowImpl::unfocus() {
 }
 
 void WindowImpl::mouseMoved(int xPos, int yPos) {
+    if (mInputRecorder) {
+        InputEvent event;
+        event.type = InputEvent::MOUSE_MOVED;
+        event.mouseMoved.x = xPos;
+        event.mouseMoved.y = yPos;
+        recordInput(event);
+    }
+    mouseMoved(xPos, yPos, 0);
+}
+
+void WindowImpl::mouseMoved(int xPos, int yPos, double timestamp) {
+    // Once here, though a move across a widget edge goes to two widgets.
+    ++mInputStats.mouseMoves;
     int oldX = mMouseX, oldY = mMouseY;
     mMouseX = xPos;
     mMouseY = yPos;
@@ -344,10 +779,12 @@ void WindowImpl::mouseMoved(int xPos, int yPos) {
         Rect r = (*iter)->getRect();
         if (!notifiedOld && r.contains(oldX, oldY)) {
             notifiedOld = true;
-            (*iter)->mouseMoved(xPos - r.left(), yPos - r.top());
+            static_cast<RenderWidget*>(*iter)->mouseMoved(
+                xPos - r.left(), yPos - r.top(), timestamp);
         } else if (!notifiedNew && r.contains(xPos, yPos)) {
             notifiedNew = true;
-            (*iter)->mouseMoved(xPos - r.left(), yPos - r.top());
+            static_cast<RenderWidget*>(*iter)->mouseMoved(
+                xPos - r.left(), yPos - r.top(), timestamp);
         }
 
         if (notifiedOld && notifiedNew)
@@ -355,12 +792,27 @@ void WindowImpl::mouseMoved(int xPos, int yPos) {
     }
 }
 void WindowImpl::mouseButton(unsigned int buttonID, bool down) {
+    if (mInputRecorder) {
+        InputEvent event;
+        event.type = InputEvent::MOUSE_BUTTON;
+        event.mouseButton.buttonID = buttonID;
+        event.mouseButton.down = down;
+        recordInput(event);
+    }
     Widget *wid = getWidgetAtPoint(mMouseX, mMouseY, true);
     if (wid) {
         (wid)->mouseButton(buttonID, down);
     }
 }
 void WindowImpl::mouseWheel(int xScroll, int yScroll) {
+    if (mInputRecorder) {
+        InputEvent event;
+        event.type = InputEvent::MOUSE_WHEEL;
+        event.mouseWheel.xScroll = xScroll;
+        event.mouseWheel.yScroll = yScroll;
+        recordInput(event);
+    }
+    ++mInputStats.wheels;
     Widget *wid = getWidgetAtPoint(mMouseX, mMouseY, true);
     if (wid) {
         wid->mouseWheel(xScroll, yScroll);
@@ -368,18 +820,111 @@ void WindowImpl::mouseWheel(int xScroll, int yScroll) {
 }
 
 void WindowImpl::textEvent(const wchar_t* evt, size_t evtLength) {
+    if (mInputRecorder) {
+        InputEvent event;
+        event.type = InputEvent::TEXT_EVENT;
+        event.textEvent.text = evt;
+        event.textEvent.length = evtLength;
+        recordInput(event);
+    }
     FrontToBackIter iter = frontIter();
     if (iter != frontEnd()) {
         (*iter)->textEvent(evt,evtLength);
     }
 }
 void WindowImpl::keyEvent(bool pressed, int mods, int vk_code, int scancode) {
+    if (mInputRecorder) {
+        InputEvent event;
+        event.type = InputEvent::KEY_EVENT;
+        event.keyEvent.pressed = pressed;
+        event.keyEvent.mods = mods;
+        event.keyEvent.vk_code = vk_code;
+        event.keyEvent.scancode = scancode;
+        recordInput(event);
+    }
     FrontToBackIter iter = frontIter();
     if (iter != frontEnd()) {
         (*iter)->keyEvent(pressed, mods, vk_code, scancode);
     }
 }
 
+void WindowImpl::injectInput(const InputEvent *events, size_t numEvents) {
+    dispatchInput(events, numEvents, -1);
+}
+
+void WindowImpl::injectReplayed(const InputEvent *events, size_t numEvents,
+                                size_t firstIndex) {
+    dispatchInput(events, numEvents, (int)firstIndex);
+}
+
+void WindowImpl::dispatchInput(const InputEvent *events, size_t numEvents,
+                               int firstReplayIndex) {
+    // Nothing can add or remove widgets until we return, so the focused
+    // one only needs finding once, and the one under the mouse once per
+    // move.
+    FrontToBackIter front = frontIter();
+    RenderWidget *focused = front != frontEnd() ?
+        static_cast<RenderWidget*>(*front) : NULL;
+    RenderWidget *pointed = NULL;
+    bool pointedValid = false;
+    // Events without a time of their own all happen now.
+    double now = 0;
+    for (size_t i = 0; i < numEvents; ++i) {
+        const InputEvent &ev = events[i];
+        mReplayIndex = firstReplayIndex < 0 ? -1 : firstReplayIndex + (int)i;
+        if (mInputRecorder) {
+            recordInput(ev);
+        }
+        double timestamp = ev.timestamp;
+        if (!timestamp) {
+            if (!now) {
+                now = Berkelium::getInputTime();
+            }
+            timestamp = now;
+        }
+        if ((ev.type == InputEvent::MOUSE_BUTTON ||
+             ev.type == InputEvent::MOUSE_WHEEL) && !pointedValid) {
+            pointed = static_cast<RenderWidget*>(
+                getWidgetAtPoint(mMouseX, mMouseY, true));
+            pointedValid = true;
+        }
+        switch (ev.type) {
+          case InputEvent::MOUSE_MOVED:
+            mouseMoved(ev.mouseMoved.x, ev.mouseMoved.y, timestamp);
+            pointedValid = false;
+            break;
+          case InputEvent::MOUSE_BUTTON:
+            if (pointed) {
+                pointed->mouseButton(ev.mouseButton.buttonID,
+                                     ev.mouseButton.down, timestamp);
+            }
+            break;
+          case InputEvent::MOUSE_WHEEL:
+            ++mInputStats.wheels;
+            if (pointed) {
+                pointed->mouseWheel(ev.mouseWheel.xScroll,
+                                    ev.mouseWheel.yScroll, timestamp);
+            }
+            break;
+          case InputEvent::KEY_EVENT:
+            if (focused) {
+                focused->keyEvent(ev.keyEvent.pressed, ev.keyEvent.mods,
+                                  ev.keyEvent.vk_code, ev.keyEvent.scancode,
+                                  timestamp);
+            }
+            break;
+          case InputEvent::TEXT_EVENT:
+            if (focused) {
+                focused->textEvent(WideString::point_to(ev.textEvent.text,
+                                                        ev.textEvent.length),
+                                   timestamp);
+            }
+            break;
+        }
+    }
+    mReplayIndex = -1;
+}
+
 
 
 void WindowImpl::resize(int width, int height) {
@@ -441,6 +986,153 @@ bool WindowImpl::canGoForward() const {
   return mController->CanGoForward();
 }
 
+ResizeStats WindowImpl::getResizeStats() const {
+    return static_cast<MemoryRenderViewHost*>(host())->Memory_GetResizeStats();
+}
+
+PaintStats WindowImpl::getPaintStats() const {
+    return static_cast<MemoryRenderViewHost*>(host())->Memory_GetPaintStats();
+}
+
+void WindowImpl::setInputCoalescing(bool enabled) {
+    mInputCoalescing = enabled;
+    if (!enabled) {
+        for (BackToFrontIter it = backIter(); it != backEnd(); ++it) {
+            static_cast<RenderWidget*>(*it)->flushInput();
+        }
+    }
+}
+
+void WindowImpl::setTextInsertThreshold(size_t length) {
+    mTextInsertThreshold = length;
+}
+
+InputStats WindowImpl::getInputStats() const {
+    return mInputStats;
+}
+
+InputLatencyStats WindowImpl::getInputLatencyStats() const {
+    return mInputLatency.getStats();
+}
+
+bool WindowImpl::startInputLatencyTrace(FileString filename) {
+    return mInputLatency.startTrace(
+        FilePath(filename.get<FilePath::StringType>()));
+}
+
+void WindowImpl::stopInputLatencyTrace() {
+    mInputLatency.stopTrace();
+}
+
+void WindowImpl::recordInput(const InputEvent &event) {
+    // Logged at the time of the call, whatever the event's timestamp.
+    mInputRecorder->record(event, base::TimeTicks::Now());
+}
+
+bool WindowImpl::startInputRecording(FileString filename) {
+    stopInputRecording();
+    InputRecorder *recorder = new InputRecorder;
+    if (!recorder->start(FilePath(filename.get<FilePath::StringType>()))) {
+        delete recorder;
+        return false;
+    }
+    mInputRecorder = recorder;
+    return true;
+}
+
+void WindowImpl::stopInputRecording() {
+    delete mInputRecorder;
+    mInputRecorder = NULL;
+}
+
+bool WindowImpl::startInputReplay(FileString filename, double speed) {
+    stopInputReplay();
+    InputReplayer *replayer = new InputReplayer;
+    if (!replayer->load(FilePath(filename.get<FilePath::StringType>()))) {
+        delete replayer;
+        return false;
+    }
+    mInputReplayer = replayer;
+    mInputReplayer->start(speed, base::TimeTicks::Now());
+    // From the message loop, not from inside the caller.
+    mReplayTimer.Start(base::TimeDelta(), this, &WindowImpl::pumpInputReplay);
+    return true;
+}
+
+void WindowImpl::stopInputReplay() {
+    if (!mInputReplayer) {
+        return;
+    }
+    mReplayTimer.Stop();
+    mInputReplayer->finish();
+    mLastReplayStats = mInputReplayer->getStats();
+    delete mInputReplayer;
+    mInputReplayer = NULL;
+}
+
+InputReplayStats WindowImpl::getInputReplayStats() const {
+    return mInputReplayer ? mInputReplayer->getStats() : mLastReplayStats;
+}
+
+void WindowImpl::pumpInputReplay() {
+    base::TimeDelta next = mInputReplayer->inject(this, base::TimeTicks::Now());
+    if (next >= base::TimeDelta()) {
+        mReplayTimer.Start(next, this, &WindowImpl::pumpInputReplay);
+    } else if (mInputReplayer->isFinished()) {
+        finishInputReplay();
+    } else {
+        // Events that change nothing on screen never get a paint.
+        mReplayTimer.Start(base::TimeDelta::FromSeconds(1), this,
+                           &WindowImpl::finishInputReplay);
+    }
+}
+
+void WindowImpl::replayInputPainted(int first, int last,
+                                    base::TimeTicks now) {
+    if (mInputReplayer && first >= 0) {
+        // Handed to the delegate by replayPainted once the paint is out.
+        mInputReplayer->onInputPainted(first, last, now);
+    }
+}
+
+void WindowImpl::replayInputUnpainted(int first, int last) {
+    if (!mInputReplayer || first < 0) {
+        return;
+    }
+    mInputReplayer->onInputUnpainted(first, last);
+    if (mInputReplayer->isFinished()) {
+        // Not from inside the RenderWidget.
+        mReplayTimer.Start(base::TimeDelta(), this,
+                           &WindowImpl::finishInputReplay);
+    }
+}
+
+void WindowImpl::replayPainted() {
+    std::vector<size_t> painted;
+    std::vector<double> latencies;
+    mInputReplayer->takePainted(&painted, &latencies);
+    for (size_t i = 0; i < painted.size() && mDelegate; ++i) {
+        mDelegate->onInputReplayed(this, painted[i], latencies[i]);
+    }
+    // The delegate may have stopped it.
+    if (mInputReplayer && mInputReplayer->isFinished()) {
+        finishInputReplay();
+    }
+}
+
+void WindowImpl::finishInputReplay() {
+    stopInputReplay();
+    if (mDelegate) {
+        mDelegate->onInputReplayDone(this);
+    }
+}
+
+void WindowImpl::onResizeComplete(int width, int height, double latency) {
+    if (mDelegate) {
+        mDelegate->onResizeComplete(this, width, height, latency);
+    }
+}
+
 void WindowImpl::SetContainerBounds (const gfx::Rect &rc) {
     mRect = rc;
     RenderWidgetHostView* myview = view();
@@ -507,36 +1199,272 @@ ContextImpl *WindowImpl::getContextImpl() const {
     return static_cast<ContextImpl*>(getContext());
 }
 
-void WindowImpl::onPaint(Widget *wid,
-                         const unsigned char *sourceBuffer,
-                         const Rect &sourceBufferRect,
-                         size_t numCopyRects,
-                         const Rect *copyRects,
-                         int dx, int dy, const Rect &scrollRect) {
-    if (mDelegate) {
+void WindowImpl::onPaint(Widget *wid, PaintFrame *frame) {
+    if (wid || !mMaxFrameRate) {
+        deliverPaint(wid, frame);
+        return;
+    }
+    // The renderer waits for the ACK of a held frame before painting again,
+    // so there is never more than one.
+    DCHECK(!mHeldFrame);
+    flushHeldPaint();
+
+    base::TimeTicks now = base::TimeTicks::Now();
+    base::TimeDelta interval = base::TimeDelta::FromMicroseconds(
+        base::Time::kMicrosecondsPerSecond / mMaxFrameRate);
+    base::TimeDelta elapsed = now - mLastPaintTime;
+    if (elapsed >= interval) {
+        mLastPaintTime = now;
+        deliverPaint(NULL, frame);
+    } else {
+        frame->addRef();
+        mHeldFrame = frame;
+        mPaintTimer.Start(interval - elapsed, this,
+                          &WindowImpl::flushHeldPaint);
+    }
+}
+
+void WindowImpl::flushHeldPaint() {
+    if (!mHeldFrame) {
+        return;
+    }
+    mPaintTimer.Stop();
+    PaintFrame *frame = mHeldFrame;
+    mHeldFrame = NULL;
+    mLastPaintTime = base::TimeTicks::Now();
+    deliverPaint(NULL, frame);
+    // Acknowledges the renderer, unless the delegate kept the frame.
+    frame->release();
+}
+
+void WindowImpl::dropHeldPaint() {
+    mPaintTimer.Stop();
+    if (mHeldFrame) {
+        PaintFrame *frame = mHeldFrame;
+        mHeldFrame = NULL;
+        frame->release();
+    }
+}
+
+const unsigned char *WindowImpl::convertPaint(
+    const unsigned char *buffer, const Rect &bufferRect,
+    size_t numRects, const Rect *rects,
+    PixelFormat format, std::vector<unsigned char> *dest)
+{
+    int width = bufferRect.width();
+    int height = bufferRect.height();
+    // Keeps its capacity from one paint to the next.
+    dest->resize(PixelConvert::getImageSize(format, width, height));
+    if (dest->empty()) {
+        return NULL;
+    }
+    for (size_t i = 0; i < numRects; ++i) {
+        // Copy rects are in page coordinates, the buffer isn't.
+        Rect rect = rects[i].translate(-bufferRect.left(), -bufferRect.top());
+        PixelConvert::convert(format, buffer, width * 4,
+                              &(*dest)[0], width, height, rect);
+    }
+    return &(*dest)[0];
+}
+
+// Whether the copy rects of frame repaint the whole view. Copy rects may
+// overlap, so the view is cut down by each of them until nothing is left.
+bool WindowImpl::coversView(const PaintFrame *frame) {
+    Rect view;
+    view.mLeft = 0;
+    view.mTop = 0;
+    view.mWidth = frame->getViewWidth();
+    view.mHeight = frame->getViewHeight();
+    mUncovered.clear();
+    mUncovered.push_back(view);
+    for (size_t i = 0; i < frame->getNumCopyRects(); ++i) {
+        mUncoveredScratch.clear();
+        for (size_t j = 0; j < mUncovered.size(); ++j) {
+            subtractRect(mUncovered[j], frame->getCopyRects()[i],
+                         &mUncoveredScratch);
+        }
+        mUncovered.swap(mUncoveredScratch);
+        if (mUncovered.empty()) {
+            return true;
+        }
+    }
+    return mUncovered.empty();
+}
+
+void WindowImpl::deliverPaint(Widget *wid, PaintFrame *frame) {
+    RenderWidget *painted = static_cast<RenderWidget*>(wid ? wid : getWidget());
+    if (painted) {
+        painted->onPaintDelivered();
+    }
+    if (mInputReplayer) {
+        replayPainted();
+    }
+    bool frameUpdated = false;
+    if (!wid && mFrameBuffer) {
+        if (mFrameBuffer->getWidth() != frame->getViewWidth() ||
+            mFrameBuffer->getHeight() != frame->getViewHeight()) {
+            // Resizing clears the frame.
+            mFrameComplete = false;
+        }
+        mFrameDirty.clear();
+        mFrameBuffer->applyPaint(frame, &mFrameDirty);
+        Root::getSingleton().getFrameBufferBudget()->touch(
+            this, mFrameBuffer->getMemorySize());
+        if (coversView(frame)) {
+            mFrameComplete = true;
+        }
+        if (!mFrameDirty.empty()) {
+            mFrameDirty.resize(coalesceRects(
+                &mFrameDirty[0], mFrameDirty.size(),
+                mCoalescing.perRectCost, mCoalescing.maxRects));
+        }
+        frameUpdated = !mFrameDirty.empty();
+        if (frameUpdated && mMailbox) {
+            mMailbox->invalidate(mFrameDirty.size(), &mFrameDirty[0]);
+            if (mFrameComplete) {
+                mMailbox->publish(*mFrameBuffer);
+            }
+        }
+        if (frameUpdated && mSharedExport) {
+            mSharedExport->invalidate(mFrameDirty.size(), &mFrameDirty[0]);
+            if (mFrameComplete) {
+                mSharedExport->publish(*mFrameBuffer);
+            }
+        }
+        if (frameUpdated && mThumbnails) {
+            mThumbnails->update(*mFrameBuffer, mFrameDirty.size(),
+                                &mFrameDirty[0]);
+        }
+    }
+    if (mCompositor) {
         if (wid) {
-            mDelegate->onWidgetPaint(
+            mCompositor->applyWidgetPaint(wid, frame);
+        } else if (frameUpdated) {
+            mCompositor->invalidate(mFrameDirty.size(), &mFrameDirty[0]);
+        }
+    }
+    if (!wid && !mCaptures.empty()) {
+        for (size_t i = 0; i < mCaptures.size(); ++i) {
+            ++mCaptures[i].numPaints;
+        }
+        if (mFrameComplete && !is_loading_) {
+            deliverCaptures(NULL, true);
+        }
+    }
+    bool paintVisible = true;
+    if (!wid && mHasPaintInterest && !mCompositor) {
+        // Only after the frame buffer has taken the whole paint.
+        bool scrollDropped;
+        paintVisible = static_cast<PaintFrameImpl*>(frame)->clipCopyRects(
+            mPaintInterest.empty() ? NULL : &mPaintInterest[0],
+            mPaintInterest.size(), &scrollDropped);
+        if (scrollDropped && host()) {
+            static_cast<MemoryRenderViewHost*>(host())->Memory_Repaint();
+        }
+    }
+    if (!mDelegate) {
+        return;
+    }
+    if (mCompositor) {
+        deliverComposited();
+    } else if (paintVisible) {
+        if (mPaintQueue) {
+            mPaintQueue->post(mDelegate, wid, frame, mPaintFormat,
+                              mDeferredPaintAck);
+        } else {
+            callPaintDelegate(mDelegate, wid, frame, mPaintFormat,
+                              mDeferredPaintAck);
+        }
+    }
+    if (!frameUpdated) {
+        return;
+    }
+    // The delegate may have turned these off from onPaint.
+    if (mFrameBufferEnabled) {
+        mDelegate->onFrameUpdated(this, mFrameBuffer,
+                                  mFrameDirty.size(), &mFrameDirty[0]);
+    }
+    if (mThumbnails) {
+        int level = mThumbnails->levels();
+        const std::vector<Rect> &dirty = mThumbnails->getDirty(level);
+        if (!dirty.empty()) {
+            mDelegate->onThumbnailUpdated(this, level,
+                                          mThumbnails->getLevel(level),
+                                          dirty.size(), &dirty[0]);
+        }
+    }
+}
+
+void WindowImpl::callPaintDelegate(WindowDelegate *delegate, Widget *wid,
+                                   PaintFrame *frame, PixelFormat format,
+                                   bool deferredAck) {
+    if (deferredAck) {
+        static_cast<PaintFrameImpl*>(frame)->setDeliveryFormat(format);
+        if (wid) {
+            delegate->onWidgetPaintFrame(this, wid, frame);
+        } else {
+            delegate->onPaintFrame(this, frame);
+        }
+    } else {
+        const unsigned char *buffer = frame->getBuffer();
+        if (format != PIXEL_FORMAT_BGRA) {
+            buffer = convertPaint(buffer, frame->getBufferRect(),
+                                  frame->getNumCopyRects(),
+                                  frame->getCopyRects(),
+                                  format, &mConvertBuffer);
+        }
+        if (wid) {
+            delegate->onWidgetPaint(
                 this, wid,
-                sourceBuffer, sourceBufferRect,
-                numCopyRects, copyRects,
-                dx, dy, scrollRect);
+                buffer, frame->getBufferRect(),
+                frame->getNumCopyRects(), frame->getCopyRects(),
+                frame->getDx(), frame->getDy(), frame->getScrollRect());
         } else {
-            mDelegate->onPaint(
+            delegate->onPaint(
                 this,
-                sourceBuffer, sourceBufferRect,
-                numCopyRects, copyRects,
-                dx, dy, scrollRect);
+                buffer, frame->getBufferRect(),
+                frame->getNumCopyRects(), frame->getCopyRects(),
+                frame->getDx(), frame->getDy(), frame->getScrollRect());
         }
     }
 }
 
+void WindowImpl::deliverComposited() {
+    if (!mFrameBuffer || !mDelegate ||
+        !mCompositor->compose(*mFrameBuffer, backIter(), backEnd())) {
+        return;
+    }
+    const std::vector<Rect> &damage = mCompositor->getDamage();
+    Rect bounds = mCompositor->getBounds();
+    const unsigned char *buffer = mCompositor->getBuffer();
+    if (mPaintFormat != PIXEL_FORMAT_BGRA) {
+        buffer = convertPaint(buffer, bounds, damage.size(), &damage[0],
+                              mPaintFormat, &mCompositedBuffer);
+    }
+    mDelegate->onPaint(this, buffer, bounds, damage.size(), &damage[0],
+                       0, 0, Rect());
+}
+
+void WindowImpl::onWidgetMoved(Widget *wid) {
+    if (mCompositor && wid != getWidget()) {
+        deliverComposited();
+    }
+}
+
 void WindowImpl::onWidgetDestroyed(Widget *wid) {
+    if (mPaintQueue) {
+        mPaintQueue->dropWidget(wid);
+    }
     if (wid != getWidget()) {
         if (mDelegate) {
             mDelegate->onWidgetDestroyed(this, wid);
         }
     }
     removeWidget(wid);
+    if (mCompositor && wid != getWidget()) {
+        mCompositor->removeWidget(wid);
+        deliverComposited();
+    }
 }
 
 /******* RenderViewHostManager::Delegate *******/
@@ -581,6 +1509,17 @@ void WindowImpl::DidStartLoading() {
 void WindowImpl::DidStopLoading() {
     SetIsLoading(false);
 
+    if (!mCaptures.empty()) {
+        base::TimeTicks now = base::TimeTicks::Now();
+        for (size_t i = 0; i < mCaptures.size(); ++i) {
+            if (mCaptures[i].loaded.is_null()) {
+                mCaptures[i].loaded = now;
+            }
+        }
+        // Make sure a paint of the finished page follows.
+        static_cast<MemoryRenderViewHost*>(host())->Memory_Repaint();
+    }
+
     if (mDelegate) {
         mDelegate->onLoadingStateChanged(this, false);
     }
@@ -805,6 +1744,13 @@ void WindowImpl::RenderViewReady(RenderViewHost* rvh) {
   bool was_crashed = is_crashed();
   SetIsCrashed(false);
 
+  if (mRepaintWhenReady) {
+      // Make up for the paints the delegate never saw.
+      mRepaintWhenReady = false;
+      static_cast<MemoryRenderViewHost*>(rvh)->Memory_Repaint();
+      repaintWidgets();
+  }
+
   // Restore the focus to the tab (otherwise the focus will be on the top
   // window).
   if (was_crashed)
@@ -820,6 +1766,36 @@ void WindowImpl::RenderViewGone(RenderViewHost* rvh) {
 
   SetIsLoading(false);
   SetIsCrashed(true);
+  if (mPaintQueue) {
+      // Paint threads must be done with the renderer's memory before
+      // Chromium frees it. The queue is dead after cancel, so start anew.
+      if (mPaintQueue->cancel()) {
+          mRepaintWhenReady = true;
+      }
+      mPaintQueue = Root::getSingleton().getPaintDispatcher()->createQueue(this);
+  }
+  // The held paint's bitmap went away with the renderer.
+  dropHeldPaint();
+  deliverCaptures(NULL, false);
+  static_cast<MemoryRenderViewHost*>(rvh)->Memory_ResetResize();
+  // Chromium frees the paint memory once we return; frames delegates
+  // still hold get a copy.
+  static_cast<MemoryRenderViewHost*>(rvh)->Memory_RendererGone();
+  for (BackToFrontIter it = backIter(); it != backEnd(); ++it) {
+      if (*it == getWidget()) {
+          continue;
+      }
+      RenderWidgetHost *widgetHost =
+          static_cast<RenderWidget*>(*it)->GetRenderWidgetHost();
+      if (widgetHost) {
+          static_cast<MemoryRenderWidgetHost*>(widgetHost)->Memory_RendererGone();
+      }
+  }
+  // Input in flight died with the renderer; no ACK or paint will come
+  // for it.
+  for (BackToFrontIter it = backIter(); it != backEnd(); ++it) {
+      static_cast<RenderWidget*>(*it)->onRendererGone();
+  }
 
   // Tell the view that we've crashed so it can prepare the sad tab page.
   //view()->OnTabCrashed();
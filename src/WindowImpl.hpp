@@ -35,8 +35,11 @@
 #include "berkelium/Widget.hpp"
 #include "berkelium/Window.hpp"
 #include "NavigationController.hpp"
+#include "InputLatencyTracker.hpp"
 #include "gfx/rect.h"
 #include "gfx/size.h"
+#include "base/time.h"
+#include "base/timer.h"
 #include "chrome/browser/renderer_host/render_widget_host.h"
 #include "chrome/browser/renderer_host/render_view_host.h"
 #include "chrome/browser/renderer_host/render_view_host_delegate.h"
@@ -50,6 +53,16 @@ namespace Berkelium {
 class WindowView;
 class RenderWidget;
 class MemoryRenderViewHost;
+class PaintFrame;
+class FrameBufferImpl;
+class PaintQueue;
+class ThumbnailPyramid;
+class WidgetCompositor;
+class FrameRecorder;
+class FrameMailboxImpl;
+class SharedFrameExport;
+class InputRecorder;
+class InputReplayer;
 struct Rect;
 class NavigationController;
 class ContextImpl;
@@ -108,9 +121,37 @@ public:
     RenderWidgetHostView *view() const;
     RenderViewHost *host() const;
 
+    // Called by the FrameBufferBudget. Only hidden windows give it up.
+    bool evictFrameBuffer();
+
     virtual Widget* getWidget() const;
 
     virtual void setTransparent(bool istrans);
+    virtual void setDeferredPaintAck(bool deferred);
+    virtual void setFrameBufferEnabled(bool enabled);
+    virtual const FrameBuffer* getFrame() const;
+    virtual void setPaintCoalescing(const PaintCoalescing &policy);
+    virtual void setMaxFrameRate(int fps);
+    virtual void setPaintFormat(PixelFormat format);
+    virtual void setDamageFilter(bool enabled, int tileSize);
+    virtual void setThreadedPaint(bool threaded);
+    virtual void captureFrame(CaptureDelegate *callback);
+    virtual void cancelCapture(CaptureDelegate *callback);
+    virtual ResizeStats getResizeStats() const;
+    virtual PaintStats getPaintStats() const;
+    virtual void setThumbnailLevel(int level);
+    virtual const FrameBuffer* getThumbnail(int level) const;
+    virtual void setPaintInterest(const Rect *rects, size_t numRects);
+    virtual void setWidgetCompositing(bool enabled);
+    virtual void setVisible(bool visible);
+    virtual bool startRecording(FileString filename, RecordFormat format,
+                                int fps, int bufferFrames);
+    virtual RecordStats stopRecording();
+    virtual RecordStats getRecordStats() const;
+    virtual FrameMailbox *getFrameMailbox();
+    virtual bool startSharedFrameExport(URLString name, int maxWidth,
+                                        int maxHeight, int numSlots);
+    virtual void stopSharedFrameExport();
 
     virtual int getId() const;
 
@@ -121,6 +162,44 @@ public:
     virtual void mouseWheel(int xScroll, int yScroll);
     virtual void textEvent(const wchar_t *evt, size_t evtLength);
     virtual void keyEvent(bool pressed, int mods, int vk_code, int scancode);
+    virtual void injectInput(const InputEvent *events, size_t numEvents);
+    virtual void setInputCoalescing(bool enabled);
+    virtual void setTextInsertThreshold(size_t length);
+    virtual InputStats getInputStats() const;
+    virtual InputLatencyStats getInputLatencyStats() const;
+    virtual bool startInputLatencyTrace(FileString filename);
+    virtual void stopInputLatencyTrace();
+    virtual bool startInputRecording(FileString filename);
+    virtual void stopInputRecording();
+    virtual bool startInputReplay(FileString filename, double speed);
+    virtual void stopInputReplay();
+    virtual InputReplayStats getInputReplayStats() const;
+
+    // For the RenderWidgets' input queues.
+    bool isInputCoalescing() const {
+        return mInputCoalescing;
+    }
+    InputStats &getMutableInputStats() {
+        return mInputStats;
+    }
+    size_t getTextInsertThreshold() const {
+        return mTextInsertThreshold;
+    }
+    InputLatencyTracker &getInputLatency() {
+        return mInputLatency;
+    }
+    // Position in the replay log of the event injectReplayed is passing
+    // on, or -1.
+    int getReplayIndex() const {
+        return mReplayIndex;
+    }
+    // Where events firstIndex onwards of a replay log go in.
+    void injectReplayed(const InputEvent *events, size_t numEvents,
+                        size_t firstIndex);
+    // The RenderWidgets' verdict on replayed events first to last; -1
+    // means the input didn't come from a replay.
+    void replayInputPainted(int first, int last, base::TimeTicks now);
+    void replayInputUnpainted(int first, int last);
 
     virtual void adjustZoom (int mode);
 
@@ -145,12 +224,14 @@ public:
     void SetContainerBounds(const gfx::Rect &rc);
     void resize(int width, int height);
 
-    void onPaint(Widget *wid,
-                 const unsigned char *sourceBuffer,
-                 const Rect &sourceBufferRect,
-                 size_t numCopyRects, const Rect *copyRects,
-                 int dx, int dy, const Rect &scrollRect);
+    void onPaint(Widget *wid, PaintFrame *frame);
+    // Calls the paint callbacks; from a paint thread if threaded paint is on.
+    void callPaintDelegate(WindowDelegate *delegate, Widget *wid,
+                           PaintFrame *frame, PixelFormat format,
+                           bool deferredAck);
     void onWidgetDestroyed(Widget *wid);
+    void onWidgetMoved(Widget *wid);
+    void onResizeComplete(int width, int height, double latency);
 
     // Called from MemoryRenderViewHost, since RenderViewHost does nothing here?!
     void OnAddMessageToConsole(
@@ -356,6 +437,27 @@ protected: /******* RenderViewHostDelegate::BrowserIntegration *******/
     virtual void OnSetSuggestResult(int32, const std::string&);
 
 private:
+    void deliverPaint(Widget *wid, PaintFrame *frame);
+    void flushHeldPaint();
+    void dropHeldPaint();
+    void mouseMoved(int xPos, int yPos, double timestamp);
+    void recordInput(const InputEvent &event);
+    void dispatchInput(const InputEvent *events, size_t numEvents,
+                       int firstReplayIndex);
+    void pumpInputReplay();
+    void replayPainted();
+    void finishInputReplay();
+    void updateFrameBuffer();
+    void freeFrameBuffer();
+    void deliverCaptures(CaptureDelegate *only, bool complete);
+    void deliverComposited();
+    void repaintWidgets();
+    void sampleRecording();
+    bool coversView(const PaintFrame *frame);
+    static const unsigned char *convertPaint(
+        const unsigned char *buffer, const Rect &bufferRect,
+        size_t numRects, const Rect *rects,
+        PixelFormat format, std::vector<unsigned char> *dest);
 
     GURL mCurrentURL;
     int zIndex;
@@ -363,6 +465,17 @@ private:
 
     int mMouseX;
     int mMouseY;
+    bool mInputCoalescing;
+    InputStats mInputStats;
+    size_t mTextInsertThreshold;
+    InputLatencyTracker mInputLatency;
+    // NULL unless startInputRecording is on.
+    InputRecorder *mInputRecorder;
+    // NULL unless a replay is in progress; injects from mReplayTimer.
+    InputReplayer *mInputReplayer;
+    int mReplayIndex;
+    base::OneShotTimer<WindowImpl> mReplayTimer;
+    InputReplayStats mLastReplayStats;
 
     gfx::Rect mRect;
 
@@ -379,8 +492,63 @@ private:
     bool received_page_title_;
     bool is_loading_;
     bool is_crashed_;
+    bool mVisible;
 
 	bool mIsReentrant;
+    bool mDeferredPaintAck;
+
+    FrameBufferImpl *mFrameBuffer;
+    bool mFrameBufferEnabled;
+    // Every pixel of mFrameBuffer has been painted at its current size.
+    bool mFrameComplete;
+    std::vector<Rect> mFrameDirty;
+    // NULL unless setThumbnailLevel is on.
+    ThumbnailPyramid *mThumbnails;
+    // NULL unless setWidgetCompositing is on.
+    WidgetCompositor *mCompositor;
+    // NULL until getFrameMailbox is first called.
+    FrameMailboxImpl *mMailbox;
+    // NULL unless startSharedFrameExport is on.
+    SharedFrameExport *mSharedExport;
+
+    struct PendingCapture {
+        CaptureDelegate *callback;
+        base::TimeTicks requested;
+        // Null while the page is still loading.
+        base::TimeTicks loaded;
+        int numPaints;
+    };
+    std::vector<PendingCapture> mCaptures;
+    // What coversView() hasn't found painted yet; kept for its capacity.
+    std::vector<Rect> mUncovered;
+    std::vector<Rect> mUncoveredScratch;
+    PaintCoalescing mCoalescing;
+    // setPaintInterest: empty rects are left out, so this can be empty
+    // with mHasPaintInterest set, which hides every paint.
+    bool mHasPaintInterest;
+    std::vector<Rect> mPaintInterest;
+
+    // setMaxFrameRate: a page paint waiting for the next interval. We hold
+    // a reference so the renderer isn't acknowledged until it is delivered.
+    int mMaxFrameRate;
+    PaintFrame *mHeldFrame;
+    base::TimeTicks mLastPaintTime;
+    base::OneShotTimer<WindowImpl> mPaintTimer;
+
+    PixelFormat mPaintFormat;
+    std::vector<unsigned char> mConvertBuffer;
+    // Composited paints are converted on the UI thread, so they can't
+    // share mConvertBuffer with a paint thread.
+    std::vector<unsigned char> mCompositedBuffer;
+
+    // Set while threaded paint is on.
+    scoped_refptr<PaintQueue> mPaintQueue;
+    // The renderer died with threaded paints undelivered.
+    bool mRepaintWhenReady;
+
+    // Set while recording; samples the frame buffer from mRecordTimer.
+    scoped_refptr<FrameRecorder> mRecorder;
+    base::RepeatingTimer<WindowImpl> mRecordTimer;
 
     // Manages creation and swapping of render views.
     RenderViewHost *mRenderViewHost;
@@ -0,0 +1,229 @@
+/*  Berkelium allocation test
+ *  paintalloc.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Feeds synthetic paints through PaintFrameImpl::update and
+// WindowImpl::onPaint under several Window settings, and fails if any of
+// them allocates on the heap once warmed up. Only the calling thread is
+// counted: the browser's own threads keep allocating meanwhile.
+//
+// Threaded paint delivery is left out, since posting to a paint thread
+// allocates a Task per batch. So is the paint rate limit, whose timer
+// does the same when a paint is held.
+
+#include "berkelium/Berkelium.hpp"
+#include "berkelium/Context.hpp"
+#include "berkelium/Window.hpp"
+#include "berkelium/WindowDelegate.hpp"
+#include "berkelium/FrameMailbox.hpp"
+#include "PaintFrameImpl.hpp"
+#include "WindowImpl.hpp"
+
+#include "base/platform_thread.h"
+#include "chrome/common/transport_dib.h"
+#include "gfx/rect.h"
+#include "gfx/size.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+using namespace Berkelium;
+
+namespace {
+PlatformThreadId gCountingThread = 0;
+size_t gAllocations = 0;
+
+void *countedAlloc(size_t size) {
+    if (gCountingThread && PlatformThread::CurrentId() == gCountingThread) {
+        ++gAllocations;
+    }
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+}
+
+void *operator new(size_t size) {
+    return countedAlloc(size);
+}
+void *operator new[](size_t size) {
+    return countedAlloc(size);
+}
+void operator delete(void *p) throw() {
+    free(p);
+}
+void operator delete[](void *p) throw() {
+    free(p);
+}
+
+namespace {
+
+const int kWidth = 800;
+const int kHeight = 600;
+const int kWarmupPaints = 64;
+const int kCountedPaints = 256;
+
+// Reads what it is given, like a delegate uploading a texture would.
+class ReadingDelegate : public WindowDelegate {
+public:
+    ReadingDelegate() : mSum(0) {}
+
+    virtual void onPaint(Window *win,
+                         const unsigned char *sourceBuffer,
+                         const Rect &sourceBufferRect,
+                         size_t numCopyRects,
+                         const Rect *copyRects,
+                         int dx, int dy,
+                         const Rect &scrollRect) {
+        for (size_t i = 0; i < numCopyRects; ++i) {
+            mSum += sourceBuffer[(copyRects[i].top() - sourceBufferRect.top()) *
+                                 sourceBufferRect.width() * 4];
+        }
+    }
+    virtual void onPaintFrame(Window *win, PaintFrame *frame) {
+        mSum += frame->getNumCopyRects();
+    }
+
+    unsigned int mSum;
+};
+
+struct Config {
+    const char *name;
+    void (*setup)(Window *win);
+};
+
+void setupPlain(Window *) {
+}
+void setupDeferred(Window *win) {
+    win->setDeferredPaintAck(true);
+}
+void setupFrameBuffer(Window *win) {
+    win->setFrameBufferEnabled(true);
+    PaintCoalescing policy = {256, 4};
+    win->setPaintCoalescing(policy);
+}
+void setupInterest(Window *win) {
+    Rect interest[2];
+    interest[0].setFromRect(gfx::Rect(0, 0, kWidth / 2, kHeight));
+    interest[1].setFromRect(gfx::Rect(kWidth / 2, kHeight / 2,
+                                      kWidth / 2, kHeight / 2));
+    win->setPaintInterest(interest, 2);
+}
+void setupFormat(Window *win) {
+    win->setPaintFormat(PIXEL_FORMAT_RGBA);
+}
+void setupThumbnails(Window *win) {
+    win->setThumbnailLevel(3);
+}
+void setupCompositing(Window *win) {
+    win->setWidgetCompositing(true);
+}
+void setupMailbox(Window *win) {
+    win->getFrameMailbox();
+}
+
+const Config kConfigs[] = {
+    {"plain", &setupPlain},
+    {"deferred ack", &setupDeferred},
+    {"frame buffer", &setupFrameBuffer},
+    {"paint interest", &setupInterest},
+    {"RGBA format", &setupFormat},
+    {"thumbnails", &setupThumbnails},
+    {"compositing", &setupCompositing},
+    {"mailbox", &setupMailbox}
+};
+
+}
+
+int main(int argc, char **argv) {
+    Berkelium::init(FileString::empty());
+    Context *context = Context::create();
+
+    TransportDIB *dib = TransportDIB::Create(kWidth * kHeight * 4, 1);
+    // Built before counting; update() only reads them.
+    std::vector<gfx::Rect> fullRects(1, gfx::Rect(0, 0, kWidth, kHeight));
+    std::vector<gfx::Rect> smallRects;
+    smallRects.push_back(gfx::Rect(10, 10, 100, 20));
+    smallRects.push_back(gfx::Rect(300, 400, 40, 40));
+    smallRects.push_back(gfx::Rect(600, 50, 150, 300));
+    gfx::Rect bitmapRect(0, 0, kWidth, kHeight);
+    gfx::Size viewSize(kWidth, kHeight);
+
+    int failures = 0;
+    for (size_t c = 0; c < sizeof(kConfigs) / sizeof(kConfigs[0]); ++c) {
+        Window *win = Window::create(context);
+        WindowImpl *impl = static_cast<WindowImpl*>(win);
+        ReadingDelegate delegate;
+        win->setDelegate(&delegate);
+        win->resize(kWidth, kHeight);
+        kConfigs[c].setup(win);
+
+        PaintFrameImpl *frame = new PaintFrameImpl;
+        for (int i = 0; i < kWarmupPaints + kCountedPaints; ++i) {
+            if (i == kWarmupPaints) {
+                gAllocations = 0;
+                gCountingThread = PlatformThread::CurrentId();
+            }
+            // A full paint first, so every buffer reaches its final size
+            // while warming up, then small paints and scrolls.
+            if (i == 0) {
+                frame->update(dib, bitmapRect, fullRects, viewSize,
+                              0, 0, gfx::Rect());
+            } else if (i % 4 == 0) {
+                frame->update(dib, bitmapRect, smallRects, viewSize,
+                              0, -20, bitmapRect);
+            } else {
+                frame->update(dib, bitmapRect, smallRects, viewSize,
+                              0, 0, gfx::Rect());
+            }
+            impl->onPaint(NULL, frame);
+        }
+        gCountingThread = 0;
+
+        printf("%-16s %u allocations in %d paints\n", kConfigs[c].name,
+               (unsigned int)gAllocations, kCountedPaints);
+        if (gAllocations) {
+            ++failures;
+        }
+        frame->detach();
+        win->destroy();
+    }
+
+    delete dib;
+    context->destroy();
+    Berkelium::destroy();
+    return failures ? 1 : 0;
+}
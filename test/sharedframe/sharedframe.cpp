@@ -0,0 +1,199 @@
+/*  Berkelium shared frame test
+ *  sharedframe.cpp
+ *
+ *  Copyright (c) 2010, The Sirikata team
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of Sirikata nor the names of its contributors may
+ *    be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Drives SharedFrameExport against SharedFrameReader in a forked process:
+// every frame the reader accepts must hold the pixels published with its
+// sequence. Also checks that a live writer's segment is never taken over,
+// and that one left by a writer that died is.
+
+#include "berkelium/Platform.hpp"
+#include "berkelium/SharedFrame.hpp"
+#include "FrameBufferImpl.hpp"
+#include "SharedFrameExport.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+
+using namespace Berkelium;
+
+namespace {
+
+const int kWidth = 320;
+const int kHeight = 240;
+const int kNumSlots = 3;
+const int kNumFrames = 200;
+
+std::string segmentName(const char *what) {
+    char name[64];
+    snprintf(name, sizeof(name), "/berkelium-test-%s-%d", what, (int)getpid());
+    return name;
+}
+
+// Every byte of frame sequence holds the low byte of the sequence.
+void fill(FrameBufferImpl *frame, int sequence) {
+    memset(frame->getMutableBuffer(), sequence & 0xff,
+           frame->getStride() * frame->getHeight());
+}
+
+bool check(const SharedFrameReader::Frame &frame) {
+    if (frame.width != kWidth || frame.height != kHeight) {
+        return false;
+    }
+    unsigned char expected = frame.sequence & 0xff;
+    for (size_t i = 0; i < (size_t)kWidth * kHeight * 4; ++i) {
+        if (frame.pixels[i] != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Child side: reads until the last frame shows up or the writer closes.
+int runReader(const std::string &name) {
+    SharedFrameReader reader;
+    for (int tries = 0; !reader.open(name.c_str()); ++tries) {
+        if (tries > 5000) {
+            fprintf(stderr, "reader: segment never appeared\n");
+            return 1;
+        }
+        usleep(1000);
+    }
+    int last = 0;
+    int checked = 0;
+    while (last < kNumFrames && reader.wait(last, 5000)) {
+        SharedFrameReader::Frame frame;
+        if (!reader.acquire(&frame)) {
+            continue;
+        }
+        bool ok = check(frame);
+        if (!reader.stillValid(frame)) {
+            // Torn; the writer came around. The next one will do.
+            continue;
+        }
+        if (!ok) {
+            fprintf(stderr, "reader: frame %d has wrong pixels\n",
+                    frame.sequence);
+            return 1;
+        }
+        last = frame.sequence;
+        ++checked;
+    }
+    if (last != kNumFrames) {
+        fprintf(stderr, "reader: stopped at frame %d\n", last);
+        return 1;
+    }
+    printf("reader: %d frames checked\n", checked);
+    return 0;
+}
+
+bool waitForChild(pid_t pid) {
+    int status;
+    return waitpid(pid, &status, 0) == pid &&
+        WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool testPublish() {
+    std::string name = segmentName("publish");
+    pid_t reader = fork();
+    if (reader == 0) {
+        int result = runReader(name);
+        fflush(stdout);
+        _exit(result);
+    }
+    SharedFrameExport writer;
+    if (!writer.open(name, kWidth, kHeight, kNumSlots)) {
+        fprintf(stderr, "couldn't create %s\n", name.c_str());
+        waitForChild(reader);
+        return false;
+    }
+    FrameBufferImpl frame;
+    frame.resize(kWidth, kHeight);
+    Rect all = frame.getBounds();
+    for (int sequence = 1; sequence <= kNumFrames; ++sequence) {
+        fill(&frame, sequence);
+        writer.invalidate(1, &all);
+        writer.publish(frame);
+        usleep(500);
+    }
+    return waitForChild(reader);
+}
+
+bool testLiveWriterKept() {
+    std::string name = segmentName("live");
+    SharedFrameExport first, second;
+    if (!first.open(name, kWidth, kHeight, kNumSlots)) {
+        fprintf(stderr, "couldn't create %s\n", name.c_str());
+        return false;
+    }
+    if (second.open(name, kWidth, kHeight, kNumSlots)) {
+        fprintf(stderr, "a live writer's segment was taken over\n");
+        return false;
+    }
+    return true;
+}
+
+bool testStaleReplaced() {
+    std::string name = segmentName("stale");
+    pid_t crashed = fork();
+    if (crashed == 0) {
+        // Dies without closing, like a crashed writer.
+        SharedFrameExport writer;
+        _exit(writer.open(name, kWidth / 2, kHeight / 2, 1) ? 0 : 1);
+    }
+    if (!waitForChild(crashed)) {
+        fprintf(stderr, "couldn't create %s\n", name.c_str());
+        return false;
+    }
+    SharedFrameExport writer;
+    if (!writer.open(name, kWidth, kHeight, kNumSlots)) {
+        fprintf(stderr, "a dead writer's segment was not replaced\n");
+        shm_unlink(name.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main() {
+    bool ok = true;
+    ok = testLiveWriterKept() && ok;
+    ok = testStaleReplaced() && ok;
+    ok = testPublish() && ok;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}